@@ -0,0 +1,33 @@
+-- Merged reagents of each guild bank
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_guild` (
+    `guild_id` int NOT NULL DEFAULT 0,
+    `item_entry` int NOT NULL,
+    `item_subclass` int NOT NULL,
+    `amount` int NOT NULL,
+    `token` bigint unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`guild_id`, `item_entry`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
+
+-- Guild deposits not merged yet, one row per deposited entry
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_guild_delta` (
+    `id` int unsigned NOT NULL AUTO_INCREMENT,
+    `guild_id` int NOT NULL DEFAULT 0,
+    `member_guid` int NOT NULL DEFAULT 0,
+    `item_entry` int NOT NULL,
+    `item_subclass` int NOT NULL,
+    `amount` int NOT NULL,
+    `merge_token` bigint unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`id`),
+    KEY `idx_guild` (`guild_id`),
+    KEY `idx_merge_token` (`merge_token`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
+
+-- What each member put into and took out of the guild bank
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_guild_contribution` (
+    `guild_id` int NOT NULL DEFAULT 0,
+    `guid` int NOT NULL DEFAULT 0,
+    `item_entry` int NOT NULL,
+    `deposited` int unsigned NOT NULL DEFAULT 0,
+    `withdrawn` int unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`guild_id`, `guid`, `item_entry`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
@@ -0,0 +1,19 @@
+-- Every change to a bank. Guild banks have guid 0, the member is in
+-- character_guid. amount_after is NULL when the resulting amount was not
+-- known, e.g. for deposits to banks that were not loaded.
+-- operation: 0 deposit, 1 withdraw, 2 refund, 3 replayed from the journal,
+--            4 guild deposit, 5 guild withdraw
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_log` (
+    `id` bigint unsigned NOT NULL AUTO_INCREMENT,
+    `account_id` int NOT NULL DEFAULT 0,
+    `guid` int NOT NULL DEFAULT 0,
+    `guild_id` int NOT NULL DEFAULT 0,
+    `character_guid` int unsigned NOT NULL DEFAULT 0,
+    `item_entry` int NOT NULL,
+    `delta` int NOT NULL,
+    `amount_after` int unsigned DEFAULT NULL,
+    `operation` tinyint unsigned NOT NULL,
+    `time` int unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`id`),
+    KEY `idx_owner` (`account_id`, `guid`, `guild_id`, `id`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
@@ -0,0 +1,15 @@
+-- One blob per bank, used with ReagentBankAccount.Storage = 1
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_packed` (
+    `account_id` int NOT NULL DEFAULT 0,
+    `guid` int NOT NULL DEFAULT 0,
+    `data` blob NOT NULL,
+    PRIMARY KEY (`account_id`, `guid`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
+
+-- Storage format the banks are in, recorded by the worldserver that moved
+-- them; 0 rows, 1 packed
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_storage` (
+    `id` tinyint unsigned NOT NULL DEFAULT 0,
+    `format` tinyint unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`id`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
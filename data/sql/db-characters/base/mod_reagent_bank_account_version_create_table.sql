@@ -0,0 +1,23 @@
+-- Bumped by every write to a bank, so worldservers sharing this DB can tell
+-- whether their cached copy is still current
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_version` (
+    `account_id` int NOT NULL DEFAULT 0,
+    `guid` int NOT NULL DEFAULT 0,
+    `version` int unsigned NOT NULL DEFAULT 0,
+    `token` bigint unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`account_id`, `guid`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
+
+-- Tokens of the versioned writes that went through
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_ops` (
+    `token` bigint unsigned NOT NULL,
+    `account_id` int NOT NULL DEFAULT 0,
+    `guid` int NOT NULL DEFAULT 0,
+    `time` int unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`token`),
+    KEY `idx_time` (`time`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
+
+-- Every bank with stored reagents needs a version row
+INSERT IGNORE INTO `mod_reagent_bank_account_version` (`account_id`, `guid`, `version`)
+SELECT DISTINCT `account_id`, `guid`, 0 FROM `mod_reagent_bank_account`;
@@ -0,0 +1,22 @@
+-- Optional replacement of the built-in reagent bank categories. Leave a
+-- table empty to keep the built-in contents for it.
+-- Category ids must be between 1 and 62; stored reagents are sorted by their
+-- item class and subclass on every visit, so ids can be changed freely.
+-- Stored reagents whose item class no longer has a row are listed under the
+-- built-in category 63, Uncategorized.
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_category` (
+    `id` int unsigned NOT NULL,
+    `name` varchar(64) NOT NULL,
+    `icon_item` int unsigned NOT NULL DEFAULT 0,
+    `sort_order` int unsigned NOT NULL DEFAULT 0,
+    PRIMARY KEY (`id`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
+
+-- Which items go to which category. Item classes without a row are not
+-- taken by the bank.
+CREATE TABLE IF NOT EXISTS `mod_reagent_bank_account_category_item_class` (
+    `item_class` int unsigned NOT NULL,
+    `item_subclass` int unsigned NOT NULL,
+    `category` int unsigned NOT NULL,
+    PRIMARY KEY (`item_class`, `item_subclass`)
+) ENGINE=InnoDB DEFAULT CHARSET=UTF8MB4;
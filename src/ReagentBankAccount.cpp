@@ -1,9 +1,51 @@
 #include "ReagentBankAccount.h"
+#include "GameTime.h"
+#include "ObjectAccessor.h"
+#include "ReagentBankAnalytics.h"
+#include "ReagentBankAudit.h"
+#include "ReagentBankBenchmark.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankEngine.h"
+#include "ReagentBankGuild.h"
+#include "ReagentBankJournal.h"
+#include "ReagentBankLedger.h"
+#include "ReagentBankSearch.h"
+#include "ReagentBankThrottle.h"
+#include <array>
 #include <unordered_map>
 
 uint32 g_maxOptionsPerPage;
 bool g_accountWideReagentBank = false;
 
+// Returns a colored item link string for display in gossip menus and chat
+// (no cache, as it may be locale-dependent)
+std::string GetReagentBankItemLink(uint32 entry, WorldSession *session)
+{
+  int loc_idx = session->GetSessionDbLocaleIndex();
+  const ItemTemplate *temp = sObjectMgr->GetItemTemplate(entry);
+  std::string name = temp ? temp->Name1 : "Unknown";
+  if (temp)
+  {
+    if (ItemLocale const *il = sObjectMgr->GetItemLocale(temp->ItemId))
+      ObjectMgr::GetLocaleString(il->Name, loc_idx, name);
+  }
+  std::ostringstream oss;
+  oss << "|c";
+  if (temp)
+    oss << std::hex << ItemQualityColors[temp->Quality] << std::dec;
+  else
+    oss << "ffffffff";
+  oss << "|Hitem:" << entry << ":0|h[" << name << "]|h|r";
+  return oss.str();
+}
+
+std::string GetReagentBankCategoryName(uint32 category)
+{
+  ReagentBankCategory const *bankCategory =
+      sReagentBankCategories->GetById(category);
+  return bankCategory ? bankCategory->name : "Reagents";
+}
+
 // AzerothCore module: Account-wide Reagent Bank
 // This script adds a reagent bank NPC that allows players to deposit and
 // withdraw reagents account-wide.
@@ -21,47 +63,11 @@ private:
   static constexpr uint32 ACTION_WITHDRAW_ONE = 900001;
   static constexpr uint32 ACTION_WITHDRAW_STACK = 900002;
   static constexpr uint32 ACTION_WITHDRAW_ALL = 900003;
-
-  // Helper to resolve the stored key pattern. We store either:
-  //  account_id = <acct>, guid = 0   (account-wide mode)
-  //  account_id = 0,      guid = <guid> (per-character mode)
-  void GetStorageKeys(Player *player, uint32 &accountKey, uint32 &guidKey) const
-  {
-    if (g_accountWideReagentBank)
-    {
-      accountKey = player->GetSession()->GetAccountId();
-      guidKey = 0;
-    }
-    else
-    {
-      accountKey = 0;
-      guidKey = player->GetGUID().GetRawValue();
-    }
-  }
+  static constexpr uint32 ACTION_GUILD_WITHDRAW_STACK = 900004;
 
   bool IsCategory(uint32 value) const
   {
-    switch (value)
-    {
-    case ITEM_SUBCLASS_CLOTH:
-    case ITEM_SUBCLASS_MEAT:
-    case ITEM_SUBCLASS_METAL_STONE:
-    case ITEM_SUBCLASS_ENCHANTING:
-    case ITEM_SUBCLASS_ELEMENTAL:
-    case ITEM_SUBCLASS_PARTS:
-    case ITEM_SUBCLASS_TRADE_GOODS_OTHER:
-    case ITEM_SUBCLASS_HERB:
-    case ITEM_SUBCLASS_LEATHER:
-    case ITEM_SUBCLASS_JEWELCRAFTING:
-    case ITEM_SUBCLASS_EXPLOSIVES:
-    case ITEM_SUBCLASS_DEVICES:
-    case ITEM_SUBCLASS_MATERIAL:
-    case ITEM_SUBCLASS_ARMOR_ENCHANTMENT:
-    case ITEM_SUBCLASS_WEAPON_ENCHANTMENT:
-      return true;
-    default:
-      return false;
-    }
+    return sReagentBankCategories->IsCategory(value);
   }
 
   // Get and cache ItemTemplate
@@ -100,546 +106,216 @@ private:
     return iconStr;
   }
 
-  // Returns a colored item link string for display in gossip menus (no cache,
-  // as it may be locale-dependent)
   std::string GetItemLink(uint32 entry, WorldSession *session) const
   {
-    int loc_idx = session->GetSessionDbLocaleIndex();
-    const ItemTemplate *temp = GetCachedItemTemplate(entry);
-    std::string name = temp ? temp->Name1 : "Unknown";
-    if (temp)
-    {
-      if (ItemLocale const *il = sObjectMgr->GetItemLocale(temp->ItemId))
-        ObjectMgr::GetLocaleString(il->Name, loc_idx, name);
-    }
-    std::ostringstream oss;
-    oss << "|c";
-    if (temp)
-      oss << std::hex << ItemQualityColors[temp->Quality] << std::dec;
-    else
-      oss << "ffffffff";
-    oss << "|Hitem:" << entry << ":0|h[" << name << "]|h|r";
-    return oss.str();
+    return GetReagentBankItemLink(entry, session);
   }
 
-  // Withdraws a stack or all of a reagent from the account-wide bank for the
-  // player
-  void WithdrawItem(Player *player, uint32 entry)
+  // The stored amount is the cached one; the withdraw reads the bank again
+  void ShowItemWithdrawMenu(Player *player, Creature *creature, uint32 category, uint16 pageIndex, uint32 itemEntry)
   {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    QueryResult result = CharacterDatabase.Query(
-        "SELECT amount FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-        accountKey, guidKey, entry);
-    if (result)
-    {
-      uint32 storedAmount = (*result)[0].Get<uint32>();
-      const ItemTemplate *temp = sObjectMgr->GetItemTemplate(entry);
-      if (!temp)
-      {
-        ChatHandler(player->GetSession())
-            .PSendSysMessage("Error: Item template not found for entry {}.",
-                             entry);
-        return;
-      }
-      uint32 stackSize = temp->GetMaxStackSize();
-      if (storedAmount <= stackSize)
-      {
-        // Give the player all of the item and remove it from the DB
-        ItemPosCountVec dest;
-        InventoryResult msg = player->CanStoreNewItem(NULL_BAG, NULL_SLOT, dest,
-                                                      entry, storedAmount);
-        if (msg == EQUIP_ERR_OK)
-        {
-          CharacterDatabase.DirectExecute(
-              "DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-              accountKey, guidKey, entry);
-          Item *item = player->StoreNewItem(dest, entry, true);
-          player->SendNewItem(item, storedAmount, true, false);
-          ChatHandler(player->GetSession())
-              .PSendSysMessage("Withdrew {} x {}.", storedAmount,
-                               temp->Name1);
-        }
-        else
+    uint32 guidLow = player->GetGUID().GetCounter();
+    uint32 generation = sReagentBankThrottle->BeginRender(guidLow);
+    ObjectGuid bankerGuid = creature->GetGUID();
+    sReagentBankLedger->LoadAsync(
+        player, [=, this](ReagentBankItemMap const &items)
         {
-          player->SendEquipError(msg, nullptr, nullptr, entry);
-          ChatHandler(player->GetSession())
-              .PSendSysMessage("Not enough bag space to withdraw {} x {}.",
-                               storedAmount, temp->Name1);
-          return;
-        }
-      }
-      else
-      {
-        // Give the player a single stack
-        ItemPosCountVec dest;
-        InventoryResult msg = player->CanStoreNewItem(NULL_BAG, NULL_SLOT, dest,
-                                                      entry, stackSize);
-        if (msg == EQUIP_ERR_OK)
-        {
-          CharacterDatabase.DirectExecute(
-              "UPDATE mod_reagent_bank_account SET amount = {} WHERE account_id = {} AND guid = {} AND item_entry = {}",
-              storedAmount - stackSize, accountKey, guidKey, entry);
-          Item *item = player->StoreNewItem(dest, entry, true);
-          player->SendNewItem(item, stackSize, true, false);
-          ChatHandler(player->GetSession())
-              .PSendSysMessage("Withdrew {} x {}.", stackSize,
-                               temp->Name1);
-        }
-        else
-        {
-          player->SendEquipError(msg, nullptr, nullptr, entry);
-          ChatHandler(player->GetSession())
-              .PSendSysMessage("Not enough bag space to withdraw {} x {}.",
-                               stackSize, temp->Name1);
-          return;
-        }
-      }
-    }
+          if (!sReagentBankThrottle->IsLatestRender(guidLow, generation))
+            return;
+          // The banker may be gone by the time the load is back
+          Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid);
+          if (!banker)
+            return;
+          auto storedItem = items.find(itemEntry);
+          uint32 stored = storedItem != items.end() ? storedItem->second.amount : 0;
+          const ItemTemplate *temp = sObjectMgr->GetItemTemplate(itemEntry);
+          constexpr int ICON_SIZE = 18;
+          constexpr int ICON_X = 0;
+          constexpr int ICON_Y = 0;
+          constexpr int GOSSIP_ICON_NONE = 0;
+          std::string icon = GetCachedItemIcon(itemEntry, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y);
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, icon + GetItemLink(itemEntry, player->GetSession()) + " |cff000000Stored: " + std::to_string(stored) + "|r", 0, 0);
+          if (stored > 0)
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw 1", ACTION_WITHDRAW_ONE, itemEntry);
+          if (stored > 1 && temp && temp->GetMaxStackSize() > 1)
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw Stack", ACTION_WITHDRAW_STACK, itemEntry);
+          if (stored > 0)
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw All", ACTION_WITHDRAW_ALL, itemEntry);
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, "Back", category, pageIndex);
+          SendGossipMenuFor(player, NPC_TEXT_ID, banker->GetGUID());
+        });
   }
 
-  // Withdraw one unit regardless of stack size
-  void WithdrawOne(Player *player, uint32 entry)
+  // Deposits all reagents from the player's bags into the account-wide bank
+  void DepositAllReagents(Player *player)
   {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    QueryResult result = CharacterDatabase.Query(
-        "SELECT amount FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-        accountKey, guidKey, entry);
-    if (!result)
-      return;
-    uint32 stored = (*result)[0].Get<uint32>();
-    if (stored == 0)
-      return;
-    const ItemTemplate *temp = sObjectMgr->GetItemTemplate(entry);
-    if (!temp)
-      return;
-    ItemPosCountVec dest;
-    InventoryResult msg = player->CanStoreNewItem(NULL_BAG, NULL_SLOT, dest, entry, 1);
-    if (msg != EQUIP_ERR_OK)
+    if (IsDatabaseBusy(player))
     {
-      player->SendEquipError(msg, nullptr, nullptr, entry);
-      ChatHandler(player->GetSession()).PSendSysMessage("Not enough space to withdraw 1 x {}.", temp->Name1);
+      CloseGossipMenuFor(player);
       return;
     }
-    if (stored == 1)
-      CharacterDatabase.DirectExecute("DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}", accountKey, guidKey, entry);
-    else
-      CharacterDatabase.DirectExecute("UPDATE mod_reagent_bank_account SET amount = {} WHERE account_id = {} AND guid = {} AND item_entry = {}", stored - 1, accountKey, guidKey, entry);
-    Item *item = player->StoreNewItem(dest, entry, true);
-    player->SendNewItem(item, 1, true, false);
-    ChatHandler(player->GetSession()).PSendSysMessage("Withdrew 1 x {}.", temp->Name1);
-  }
-
-  // Withdraw up to one full stack (or remaining if smaller)
-  void WithdrawStack(Player *player, uint32 entry)
-  {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    QueryResult result = CharacterDatabase.Query(
-        "SELECT amount FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-        accountKey, guidKey, entry);
-    if (!result)
-      return;
-    uint32 stored = (*result)[0].Get<uint32>();
-    if (stored == 0)
-      return;
-    const ItemTemplate *temp = sObjectMgr->GetItemTemplate(entry);
-    if (!temp)
-      return;
-    uint32 stackSize = temp->GetMaxStackSize();
-    uint32 toGive = std::min(stackSize, stored);
-    ItemPosCountVec dest;
-    InventoryResult msg = player->CanStoreNewItem(NULL_BAG, NULL_SLOT, dest, entry, toGive);
-    if (msg != EQUIP_ERR_OK)
+    // A deposit is already in flight, it will pick these reagents up
+    if (!sReagentBankThrottle->BeginDeposit(player->GetGUID().GetCounter()))
     {
-      player->SendEquipError(msg, nullptr, nullptr, entry);
-      ChatHandler(player->GetSession()).PSendSysMessage("Not enough space to withdraw {} x {}.", toGive, temp->Name1);
+      ChatHandler(player->GetSession())
+          .SendSysMessage("Your previous deposit is still being saved; these reagents will follow.");
+      CloseGossipMenuFor(player);
       return;
     }
-    if (toGive == stored)
-      CharacterDatabase.DirectExecute("DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}", accountKey, guidKey, entry);
-    else
-      CharacterDatabase.DirectExecute("UPDATE mod_reagent_bank_account SET amount = {} WHERE account_id = {} AND guid = {} AND item_entry = {}", stored - toGive, accountKey, guidKey, entry);
-    Item *item = player->StoreNewItem(dest, entry, true);
-    player->SendNewItem(item, toGive, true, false);
-    ChatHandler(player->GetSession()).PSendSysMessage("Withdrew {} x {}.", toGive, temp->Name1);
+    DepositAndReport(player, "No reagents to deposit.");
+    CloseGossipMenuFor(player);
   }
 
-  // Withdraw all (multiple stacks as needed)
-  void WithdrawAllOfItem(Player *player, uint32 entry)
+  // Deposits all reagents under the in-flight mark the caller took and
+  // reports them; the gossip is left alone, the player may be talking to
+  // another NPC by the time a merged deposit follows. Nothing is reported
+  // for an empty deposit without emptyMessage.
+  void DepositAndReport(Player *player, char const *emptyMessage)
   {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    QueryResult result = CharacterDatabase.Query(
-        "SELECT amount FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-        accountKey, guidKey, entry);
-    if (!result)
-      return;
-    uint32 remaining = (*result)[0].Get<uint32>();
-    if (remaining == 0)
-      return;
-    const ItemTemplate *temp = sObjectMgr->GetItemTemplate(entry);
-    if (!temp)
-      return;
-    uint32 stackSize = temp->GetMaxStackSize();
-    uint32 givenTotal = 0;
-    while (remaining > 0)
-    {
-      uint32 toGive = std::min(stackSize, remaining);
-      ItemPosCountVec dest;
-      InventoryResult msg = player->CanStoreNewItem(NULL_BAG, NULL_SLOT, dest, entry, toGive);
-      if (msg != EQUIP_ERR_OK)
-      {
-        player->SendEquipError(msg, nullptr, nullptr, entry);
-        ChatHandler(player->GetSession()).PSendSysMessage("Bag full after withdrawing {} x {} (remaining {}).", givenTotal, temp->Name1, remaining);
-        break;
-      }
-      Item *item = player->StoreNewItem(dest, entry, true);
-      player->SendNewItem(item, toGive, true, false);
-      givenTotal += toGive;
-      remaining -= toGive;
-    }
-    if (remaining == 0)
-      CharacterDatabase.DirectExecute("DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}", accountKey, guidKey, entry);
-    else
-      CharacterDatabase.DirectExecute("UPDATE mod_reagent_bank_account SET amount = {} WHERE account_id = {} AND guid = {} AND item_entry = {}", remaining, accountKey, guidKey, entry);
-    if (givenTotal > 0)
-      ChatHandler(player->GetSession()).PSendSysMessage("Withdrew {} x {}.", givenTotal, temp->Name1);
+    ObjectGuid playerGuid = player->GetGUID();
+    // Repeated deposits are merged until it lands
+    ReagentBankPlayerBags bags(player);
+    std::vector<ReagentBankItemAmount> deposits =
+        sReagentBankEngine->DepositAllReagents(
+            bags, [=, this]() { FinishDeposit(playerGuid); });
+    if (deposits.empty())
+      FinishDeposit(playerGuid);
+
+    if (!deposits.empty() || emptyMessage)
+      sReagentBankEngine->SendDepositFeedback(bags, deposits, emptyMessage);
   }
 
-  void ShowItemWithdrawMenu(Player *player, Creature *creature, uint32 category, uint16 pageIndex, uint32 itemEntry)
+  // Deposits are refused while the bank's DB queue is full; the reagents
+  // simply stay in the bags
+  bool IsDatabaseBusy(Player *player)
   {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    QueryResult result = CharacterDatabase.Query(
-        "SELECT amount FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-        accountKey, guidKey, itemEntry);
-    uint32 stored = result ? (*result)[0].Get<uint32>() : 0;
-    const ItemTemplate *temp = sObjectMgr->GetItemTemplate(itemEntry);
-    std::string name = temp ? temp->Name1 : "Unknown";
-    player->PlayerTalkClass->ClearMenus();
-    constexpr int ICON_SIZE = 18;
-    constexpr int ICON_X = 0;
-    constexpr int ICON_Y = 0;
-    constexpr int GOSSIP_ICON_NONE = 0;
-    std::string icon = GetCachedItemIcon(itemEntry, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE, icon + GetItemLink(itemEntry, player->GetSession()) + " |cff000000Stored: " + std::to_string(stored) + "|r", 0, 0);
-    if (stored > 0)
-      AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw 1", ACTION_WITHDRAW_ONE, itemEntry);
-    if (stored > 1 && temp && temp->GetMaxStackSize() > 1)
-      AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw Stack", ACTION_WITHDRAW_STACK, itemEntry);
-    if (stored > 0)
-      AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw All", ACTION_WITHDRAW_ALL, itemEntry);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE, "Back", category, pageIndex);
-    SendGossipMenuFor(player, NPC_TEXT_ID, creature->GetGUID());
+    if (!sReagentBankDatabasePool->IsBusy())
+      return false;
+    ChatHandler(player->GetSession())
+        .SendSysMessage("The reagent bank is busy, please try again in a moment.");
+    return true;
   }
 
-  // Updates the item count maps and removes the item from the player's
-  // inventory
-  void UpdateItemCount(std::map<uint32, uint32> &entryToAmountMap,
-                       std::map<uint32, uint32> &entryToSubclassMap,
-                       std::map<uint32, uint32> &itemsAddedMap, Item *pItem,
-                       Player *player, uint32 bagSlot, uint32 itemSlot)
+  // Releases the in-flight deposit and runs the deposits merged into it
+  void FinishDeposit(ObjectGuid playerGuid)
   {
-    uint32 count = pItem->GetCount();
-    ItemTemplate const *itemTemplate = pItem->GetTemplate();
-
-    // Only allow trade goods and gems, and skip unique items
-    if (!(itemTemplate->Class == ITEM_CLASS_TRADE_GOODS ||
-          itemTemplate->Class == ITEM_CLASS_GEM) ||
-        itemTemplate->GetMaxStackSize() == 1)
+    if (!sReagentBankThrottle->EndDeposit(playerGuid.GetCounter()))
       return;
-    uint32 itemEntry = itemTemplate->ItemId;
-    uint32 itemSubclass = itemTemplate->SubClass;
-
-    // Put gems to ITEM_SUBCLASS_JEWELCRAFTING section
-    if (itemTemplate->Class == ITEM_CLASS_GEM)
-    {
-      itemSubclass = ITEM_SUBCLASS_JEWELCRAFTING;
-    }
-
-    // Update or add to the amount and subclass maps
-    if (!entryToAmountMap.count(itemEntry))
-    {
-      entryToAmountMap[itemEntry] = count;
-      entryToSubclassMap[itemEntry] = itemSubclass;
-    }
-    else
-    {
-      uint32 existingCount = entryToAmountMap.find(itemEntry)->second;
-      entryToAmountMap[itemEntry] = existingCount + count;
-    }
-
-    // Track what was deposited for feedback
-    if (!itemsAddedMap.count(itemEntry))
-    {
-      itemsAddedMap[itemEntry] = count;
-    }
-    else
-    {
-      uint32 existingCount = itemsAddedMap.find(itemEntry)->second;
-      itemsAddedMap[itemEntry] = existingCount + count;
-    }
-
-    // Remove the item from the player's inventory
-    player->DestroyItem(bagSlot, itemSlot, true);
+    Player *player = ObjectAccessor::FindConnectedPlayer(playerGuid);
+    if (!player || IsDatabaseBusy(player) ||
+        !sReagentBankThrottle->BeginDeposit(playerGuid.GetCounter()))
+      return;
+    DepositAndReport(player, nullptr);
   }
 
-  // Deposits all reagents from the player's bags into the account-wide bank
-  void DepositAllReagents(Player *player)
+  void DepositAllReagentsForCategory(Player *player, uint32 item_subclass)
   {
-    WorldSession *session = player->GetSession();
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    std::string query = "SELECT item_entry, item_subclass, amount FROM mod_reagent_bank_account WHERE account_id = " + std::to_string(accountKey) + " AND guid = " + std::to_string(guidKey);
-    session->GetQueryProcessor().AddCallback(
-        CharacterDatabase.AsyncQuery(query).WithCallback(
-            [=, this](QueryResult result)
-            {
-              std::map<uint32, uint32> entryToAmountMap;
-              std::map<uint32, uint32> entryToSubclassMap;
-              std::map<uint32, uint32> itemsAddedMap;
-              if (result)
-              {
-                do
-                {
-                  uint32 itemEntry = (*result)[0].Get<uint32>();
-                  uint32 itemSubclass = (*result)[1].Get<uint32>();
-                  uint32 itemAmount = (*result)[2].Get<uint32>();
-                  entryToAmountMap[itemEntry] = itemAmount;
-                  entryToSubclassMap[itemEntry] = itemSubclass;
-                } while (result->NextRow());
-              }
-              // Inventory Items
-              for (uint8 i = INVENTORY_SLOT_ITEM_START;
-                   i < INVENTORY_SLOT_ITEM_END; ++i)
-              {
-                if (Item *pItem =
-                        player->GetItemByPos(INVENTORY_SLOT_BAG_0, i))
-                {
-                  UpdateItemCount(entryToAmountMap, entryToSubclassMap,
-                                  itemsAddedMap, pItem, player,
-                                  INVENTORY_SLOT_BAG_0, i);
-                }
-              }
-              // Bag Items
-              for (uint32 i = INVENTORY_SLOT_BAG_START;
-                   i < INVENTORY_SLOT_BAG_END; i++)
-              {
-                Bag *bag = player->GetBagByPos(i);
-                if (!bag)
-                  continue;
-                for (uint32 j = 0; j < bag->GetBagSize(); j++)
-                {
-                  if (Item *pItem = player->GetItemByPos(i, j))
-                  {
-                    UpdateItemCount(entryToAmountMap, entryToSubclassMap,
-                                    itemsAddedMap, pItem, player, i, j);
-                  }
-                }
-              }
-              // Write all changes to the DB in a transaction
-              if (entryToAmountMap.size() != 0)
-              {
-                auto trans = CharacterDatabase.BeginTransaction();
-                for (std::pair<uint32, uint32> mapEntry : entryToAmountMap)
-                {
-                  uint32 itemEntry = mapEntry.first;
-                  uint32 itemAmount = mapEntry.second;
-                  uint32 itemSubclass =
-                      entryToSubclassMap.find(itemEntry)->second;
-                  trans->Append("REPLACE INTO mod_reagent_bank_account (account_id, guid, item_entry, item_subclass, amount) VALUES ({}, {}, {}, {}, {})",
-                                accountKey, guidKey, itemEntry, itemSubclass, itemAmount);
-                }
-                CharacterDatabase.CommitTransaction(
-                    trans); // <-- just call, don't check return value
-              }
-              // Feedback to player
-              if (itemsAddedMap.size() != 0)
-              {
-                ChatHandler(player->GetSession())
-                    .SendSysMessage("The following was deposited:");
-                for (std::pair<uint32, uint32> mapEntry : itemsAddedMap)
-                {
-                  uint32 itemEntry = mapEntry.first;
-                  uint32 itemAmount = mapEntry.second;
-                  ItemTemplate const *itemTemplate =
-                      sObjectMgr->GetItemTemplate(itemEntry);
-                  std::string itemName = itemTemplate->Name1;
-                  ChatHandler(player->GetSession())
-                      .SendSysMessage(std::to_string(itemAmount) + " " +
-                                      itemName);
-                }
-              }
-              else
-              {
-                ChatHandler(player->GetSession())
-                    .PSendSysMessage("No reagents to deposit.");
-              }
-            }));
-
+    if (IsDatabaseBusy(player))
+    {
+      CloseGossipMenuFor(player);
+      return;
+    }
+    ReagentBankPlayerBags bags(player);
+    std::vector<ReagentBankItemAmount> deposits =
+        sReagentBankEngine->DepositAllReagentsForCategory(bags, item_subclass);
+    sReagentBankEngine->SendDepositFeedback(
+        bags, deposits, "No reagents to deposit in this category.");
     CloseGossipMenuFor(player);
   }
 
-  void DepositAllReagentsForCategory(Player *player, uint32 item_subclass)
+  // Deposits all reagents from the player's bags into the guild bank
+  void DepositAllReagentsToGuild(Player *player)
   {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-
-    std::map<uint32, uint32> entryToAmountMap;
-    std::map<uint32, uint32> entryToSubclassMap;
-    std::map<uint32, uint32> itemsAddedMap;
-
-    // Inventory Items
-    for (uint8 i = INVENTORY_SLOT_ITEM_START; i < INVENTORY_SLOT_ITEM_END;
-         ++i)
-    {
-      if (Item *pItem = player->GetItemByPos(INVENTORY_SLOT_BAG_0, i))
-      {
-        ItemTemplate const *itemTemplate = pItem->GetTemplate();
-        uint32 subclass = (itemTemplate->Class == ITEM_CLASS_GEM)
-                              ? ITEM_SUBCLASS_JEWELCRAFTING
-                              : itemTemplate->SubClass;
-        if ((itemTemplate->Class == ITEM_CLASS_TRADE_GOODS ||
-             itemTemplate->Class == ITEM_CLASS_GEM) &&
-            itemTemplate->GetMaxStackSize() > 1 && subclass == item_subclass)
-        {
-          UpdateItemCount(entryToAmountMap, entryToSubclassMap, itemsAddedMap,
-                          pItem, player, INVENTORY_SLOT_BAG_0, i);
-        }
-      }
-    }
-    // Bag Items
-    for (uint32 i = INVENTORY_SLOT_BAG_START; i < INVENTORY_SLOT_BAG_END; i++)
-    {
-      Bag *bag = player->GetBagByPos(i);
-      if (!bag)
-        continue;
-      for (uint32 j = 0; j < bag->GetBagSize(); j++)
-      {
-        if (Item *pItem = player->GetItemByPos(i, j))
-        {
-          ItemTemplate const *itemTemplate = pItem->GetTemplate();
-          uint32 subclass = (itemTemplate->Class == ITEM_CLASS_GEM)
-                                ? ITEM_SUBCLASS_JEWELCRAFTING
-                                : itemTemplate->SubClass;
-          if ((itemTemplate->Class == ITEM_CLASS_TRADE_GOODS ||
-               itemTemplate->Class == ITEM_CLASS_GEM) &&
-              itemTemplate->GetMaxStackSize() > 1 &&
-              subclass == item_subclass)
-          {
-            UpdateItemCount(entryToAmountMap, entryToSubclassMap, itemsAddedMap,
-                            pItem, player, i, j);
-          }
-        }
-      }
-    }
-    // Write all changes to the DB in a transaction
-    if (entryToAmountMap.size() != 0)
-    {
-      auto trans = CharacterDatabase.BeginTransaction();
-      for (std::pair<uint32, uint32> mapEntry : entryToAmountMap)
-      {
-        uint32 itemEntry = mapEntry.first;
-        uint32 itemAmount = mapEntry.second;
-        uint32 itemSubclass = entryToSubclassMap.find(itemEntry)->second;
-        trans->Append("REPLACE INTO mod_reagent_bank_account (account_id, guid, item_entry, item_subclass, amount) VALUES ({}, {}, {}, {}, {})",
-                      accountKey, guidKey, itemEntry, itemSubclass, itemAmount);
-      }
-      CharacterDatabase.CommitTransaction(trans);
-    }
-    // Feedback to player
-    if (itemsAddedMap.size() != 0)
-    {
-      ChatHandler(player->GetSession())
-          .SendSysMessage("The following was deposited:");
-      for (std::pair<uint32, uint32> mapEntry : itemsAddedMap)
-      {
-        uint32 itemEntry = mapEntry.first;
-        uint32 itemAmount = mapEntry.second;
-        ItemTemplate const *itemTemplate =
-            sObjectMgr->GetItemTemplate(itemEntry);
-        std::string itemName = itemTemplate->Name1;
-        ChatHandler(player->GetSession())
-            .SendSysMessage(std::to_string(itemAmount) + " " + itemName);
-      }
-    }
-    else
+    if (IsDatabaseBusy(player))
+      return;
+    ReagentBankPlayerBags bags(player);
+    std::vector<uint32> itemGuids;
+    std::vector<ReagentBankItemAmount> deposits = bags.TakeReagents(
+        [](ItemTemplate const *) { return true; }, itemGuids);
+    if (!deposits.empty())
     {
-      ChatHandler(player->GetSession())
-          .PSendSysMessage("No reagents to deposit in this category.");
+      ReagentBankOwner owner = GetReagentBankGuildOwner(player);
+      sReagentBankGuild->Deposit(owner, deposits, itemGuids);
+      sReagentBankAudit->Record(owner, owner.guid, deposits,
+                                AUDIT_GUILD_DEPOSIT);
     }
-    CloseGossipMenuFor(player);
+    sReagentBankEngine->SendDepositFeedback(bags, deposits,
+                                            "No reagents to deposit.");
   }
 
-  // Helper: Withdraw all items in a category for the player
-  void WithdrawAllInCategory(Player *player, uint32 item_subclass)
+  // Withdraws up to one stack of a guild reagent, if the guild rank allows
+  // it, then shows the guild page again. The bag space is checked first, so
+  // the guild rarely has to take anything back; nothing blocks meanwhile.
+  void WithdrawGuildStack(Player *player, Creature *creature, uint32 entry)
   {
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    QueryResult result = CharacterDatabase.Query(
-        "SELECT item_entry, amount FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_subclass = {}",
-        accountKey, guidKey, item_subclass);
-
-    if (!result)
+    if (!sReagentBankGuild->CanWithdraw(player))
     {
       ChatHandler(player->GetSession())
-          .PSendSysMessage("No reagents to withdraw in this category.");
+          .SendSysMessage("Your guild rank may not withdraw guild reagents.");
+      ShowGuildReagents(player, creature, 0);
       return;
     }
-
-    bool anyWithdrawn = false;
-    do
+    ItemTemplate const *temp = GetCachedItemTemplate(entry);
+    if (!temp || IsDatabaseBusy(player))
     {
-      uint32 itemEntry = (*result)[0].Get<uint32>();
-      uint32 amount = (*result)[1].Get<uint32>();
-      const ItemTemplate *temp = sObjectMgr->GetItemTemplate(itemEntry);
-      if (!temp)
-        continue;
-
-      uint32 stackSize = temp->GetMaxStackSize();
-      uint32 remaining = amount;
-      while (remaining > 0)
-      {
-        uint32 toGive = std::min(stackSize, remaining);
-        ItemPosCountVec dest;
-        InventoryResult msg = player->CanStoreNewItem(NULL_BAG, NULL_SLOT, dest,
-                                                      itemEntry, toGive);
-        if (msg == EQUIP_ERR_OK)
+      ShowGuildReagents(player, creature, 0);
+      return;
+    }
+    ObjectGuid playerGuid = player->GetGUID();
+    ObjectGuid bankerGuid = creature->GetGUID();
+    ReagentBankOwner owner = GetReagentBankGuildOwner(player);
+    auto bags = std::make_shared<ReagentBankPlayerBags>(player);
+    auto showPage = [this, playerGuid, bankerGuid]()
+    {
+      Player *player = ObjectAccessor::FindConnectedPlayer(playerGuid);
+      if (!player)
+        return;
+      if (Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid))
+        ShowGuildReagents(player, banker, 0);
+    };
+    sReagentBankGuild->TakeAsync(
+        owner, entry,
+        [bags, temp](uint32 stored) -> uint32
         {
-          // Remove or update the reagent in the DB
-          if (toGive == remaining)
-            CharacterDatabase.DirectExecute(
-                "DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {} AND item_entry = {}",
-                accountKey, guidKey, itemEntry);
-          else
-            CharacterDatabase.DirectExecute(
-                "UPDATE mod_reagent_bank_account SET amount = {} WHERE account_id = {} AND guid = {} AND item_entry = {}",
-                remaining - toGive, accountKey, guidKey, itemEntry);
-
-          Item *item = player->StoreNewItem(dest, itemEntry, true);
-          player->SendNewItem(item, toGive, true, false);
-          ChatHandler(player->GetSession())
-              .PSendSysMessage("Withdrew {} x {}.", toGive,
-                               temp->Name1);
-          anyWithdrawn = true;
-          remaining -= toGive;
-        }
-        else
+          if (!bags->IsAvailable())
+            return 0;
+          if (!stored)
+          {
+            bags->SendMessage("Your guild has none of these stored.");
+            return 0;
+          }
+          uint32 toGive = bags->PlanSpace().Reserve(
+              temp, std::min(stored, temp->GetMaxStackSize()));
+          if (!toGive)
+            bags->SendNoSpace(temp, std::min(stored, temp->GetMaxStackSize()));
+          return toGive;
+        },
+        [=](uint32 planned, bool taken, uint32 stored)
         {
-          player->SendEquipError(msg, nullptr, nullptr, itemEntry);
-          ChatHandler(player->GetSession())
-              .PSendSysMessage("Not enough bag space to withdraw {} x {}.",
-                               toGive, temp->Name1);
-          break;
-        }
-      }
-    } while (result->NextRow());
-
-    if (!anyWithdrawn)
-      ChatHandler(player->GetSession())
-          .PSendSysMessage("No reagents withdrawn.");
+          if (taken)
+          {
+            sReagentBankAudit->Record(owner, owner.guid, entry,
+                                      -int32(planned), stored - planned,
+                                      AUDIT_GUILD_WITHDRAW);
+            // Whatever no longer fits, or all of it once the player is
+            // gone, goes back to the guild
+            uint32 given = bags->IsAvailable() ? bags->Store(temp, planned) : 0;
+            if (given < planned)
+            {
+              std::vector<ReagentBankItemAmount> refund = {
+                  {entry, GetReagentBankCategory(temp), planned - given}};
+              sReagentBankGuild->Deposit(owner, refund, {});
+              sReagentBankAudit->Record(owner, owner.guid, refund,
+                                        AUDIT_GUILD_DEPOSIT);
+            }
+            if (given)
+              bags->SendMessage(Acore::StringFormat("Withdrew {} x {}.", given,
+                                                    temp->Name1));
+          }
+          else if (planned && bags->IsAvailable())
+            bags->SendMessage("Another guild member withdrew these first, please try again.");
+          showPage();
+        });
   }
 
 public:
@@ -650,98 +326,101 @@ public:
         "ReagentBankAccount.MaxOptionsPerPage", DEFAULT_MAX_OPTIONS);
     g_accountWideReagentBank =
         sConfigMgr->GetOption<bool>("ReagentBankAccount.AccountWide", false);
+    sReagentBankDatabasePool->LoadConfig();
+    sReagentBankLedger->LoadConfig();
+    sReagentBankThrottle->LoadConfig();
+    sReagentBankJournal->LoadConfig();
+    sReagentBankGuild->LoadConfig();
+    sReagentBankAnalytics->LoadConfig();
+    sReagentBankAudit->LoadConfig();
+  }
+
+  // Groups digits by thousands, 3480 -> "3,480"
+  static std::string FormatAmount(uint64 amount)
+  {
+    std::string digits = std::to_string(amount);
+    for (int i = int(digits.size()) - 3; i > 0; i -= 3)
+      digits.insert(i, ",");
+    return digits;
   }
 
-  // Main menu for the reagent banker NPC
+  // Main menu for the reagent banker NPC. Every category shows what the
+  // player has stored in it and empty ones are left out; the counts come
+  // from the player's bank, which is one query on the first visit and the
+  // ledger's cache afterwards.
   bool OnGossipHello(Player *player, Creature *creature) override
+  {
+    uint32 guidLow = player->GetGUID().GetCounter();
+    ObjectGuid bankerGuid = creature->GetGUID();
+    uint32 generation = sReagentBankThrottle->BeginRender(guidLow);
+    sReagentBankLedger->LoadAsync(
+        player, [=, this](ReagentBankItemMap const &items)
+        {
+          if (!sReagentBankThrottle->IsLatestRender(guidLow, generation))
+            return;
+          // The banker may be gone by the time the load is back
+          Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid);
+          if (!banker)
+            return;
+          ShowMainMenu(player, banker, items);
+        });
+    return true;
+  }
+
+  void ShowMainMenu(Player *player, Creature *creature,
+                    ReagentBankItemMap const &items)
   {
     constexpr int MAIN_ICON_SIZE = 24;
     constexpr int MAIN_ICON_X = 0;
     constexpr int MAIN_ICON_Y = 0;
     constexpr int GOSSIP_ICON_NONE = 0;
 
+    struct CategoryCount
+    {
+      uint32 types = 0;
+      uint64 amount = 0;
+    };
+    std::array<CategoryCount, MAX_REAGENT_BANK_CATEGORIES> counts{};
+    for (auto const &itr : items)
+    {
+      uint32 category = GetReagentBankCategory(itr.first);
+      if (category == NO_REAGENT_BANK_CATEGORY)
+        continue;
+      ++counts[category].types;
+      counts[category].amount += itr.second.amount;
+    }
+
     AddGossipItemFor(player, GOSSIP_ICON_NONE, "Deposit All Reagents",
                      DEPOSIT_ALL_REAGENTS, 0);
     AddGossipItemFor(player, GOSSIP_ICON_NONE, "Withdraw All Reagents",
                      WITHDRAW_ALL_REAGENTS, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(2589, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Cloth",
-                     ITEM_SUBCLASS_CLOTH, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(12208, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Meat",
-                     ITEM_SUBCLASS_MEAT, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(2772, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Metal & Stone",
-                     ITEM_SUBCLASS_METAL_STONE, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(10940, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Enchanting",
-                     ITEM_SUBCLASS_ENCHANTING, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(7068, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Elemental",
-                     ITEM_SUBCLASS_ELEMENTAL, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(4359, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Parts",
-                     ITEM_SUBCLASS_PARTS, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(2604, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Other Trade Goods",
-                     ITEM_SUBCLASS_TRADE_GOODS_OTHER, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(2453, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Herb",
-                     ITEM_SUBCLASS_HERB, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(2318, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Leather",
-                     ITEM_SUBCLASS_LEATHER, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(1206, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Jewelcrafting",
-                     ITEM_SUBCLASS_JEWELCRAFTING, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(4358, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Explosives",
-                     ITEM_SUBCLASS_EXPLOSIVES, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(4388, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Devices",
-                     ITEM_SUBCLASS_DEVICES, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(23572, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Nether Material",
-                     ITEM_SUBCLASS_MATERIAL, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(38682, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Armor Vellum",
-                     ITEM_SUBCLASS_ARMOR_ENCHANTMENT, 0);
-    AddGossipItemFor(player, GOSSIP_ICON_NONE,
-                     GetCachedItemIcon(39349, MAIN_ICON_SIZE, MAIN_ICON_SIZE,
-                                       MAIN_ICON_X, MAIN_ICON_Y) +
-                         "Weapon Vellum",
-                     ITEM_SUBCLASS_WEAPON_ENCHANTMENT, 0);
+    AddGossipItemFor(player, GOSSIP_ICON_NONE, "Search Reagents",
+                     SEARCH_REAGENTS, 0, "Enter part of the reagent name.", 0,
+                     true);
+    if (sReagentBankGuild->IsEnabled() && player->GetGuildId())
+      AddGossipItemFor(player, GOSSIP_ICON_NONE, "Guild Reagents",
+                       GUILD_REAGENTS, 0);
+    if (sReagentBankAudit->IsEnabled())
+      AddGossipItemFor(player, GOSSIP_ICON_NONE, "Recent Transactions",
+                       TRANSACTION_HISTORY, 0);
+    for (ReagentBankCategory const &category :
+         sReagentBankCategories->GetAll())
+    {
+      CategoryCount const &count = counts[category.id];
+      if (!count.types)
+        continue;
+      AddGossipItemFor(player, GOSSIP_ICON_NONE,
+                       GetCachedItemIcon(category.iconItem, MAIN_ICON_SIZE,
+                                         MAIN_ICON_SIZE, MAIN_ICON_X,
+                                         MAIN_ICON_Y) +
+                           category.name + " (" +
+                           std::to_string(count.types) +
+                           (count.types == 1 ? " type, " : " types, ") +
+                           FormatAmount(count.amount) + ")",
+                       category.id, 0);
+    }
 
     SendGossipMenuFor(player, NPC_TEXT_ID, creature->GetGUID());
-    return true;
   }
 
   // Handles menu selections and confirmation dialogs
@@ -750,6 +429,15 @@ public:
   {
     player->PlayerTalkClass->ClearMenus();
 
+    if (item_subclass != MAIN_MENU &&
+        !sReagentBankThrottle->Allow(player->GetGUID().GetCounter()))
+    {
+      ChatHandler(player->GetSession())
+          .SendSysMessage("The reagent banker is busy, please slow down.");
+      CloseGossipMenuFor(player);
+      return true;
+    }
+
     if (item_subclass == DEPOSIT_ALL_REAGENTS)
     {
       if (gossipPageNumber == 0)
@@ -766,31 +454,17 @@ public:
     }
     else if (item_subclass == WITHDRAW_ALL_REAGENTS)
     {
+      // The outcome is reported in the chat once the withdraw committed
+      auto bags = std::make_shared<ReagentBankPlayerBags>(player);
       if (gossipPageNumber == 0)
       {
         // Main menu: withdraw all categories
-        std::vector<uint32> subclasses = {ITEM_SUBCLASS_CLOTH,
-                                          ITEM_SUBCLASS_MEAT,
-                                          ITEM_SUBCLASS_METAL_STONE,
-                                          ITEM_SUBCLASS_ENCHANTING,
-                                          ITEM_SUBCLASS_ELEMENTAL,
-                                          ITEM_SUBCLASS_PARTS,
-                                          ITEM_SUBCLASS_TRADE_GOODS_OTHER,
-                                          ITEM_SUBCLASS_HERB,
-                                          ITEM_SUBCLASS_LEATHER,
-                                          ITEM_SUBCLASS_JEWELCRAFTING,
-                                          ITEM_SUBCLASS_EXPLOSIVES,
-                                          ITEM_SUBCLASS_DEVICES,
-                                          ITEM_SUBCLASS_MATERIAL,
-                                          ITEM_SUBCLASS_ARMOR_ENCHANTMENT,
-                                          ITEM_SUBCLASS_WEAPON_ENCHANTMENT};
-        for (uint32 subclass : subclasses)
-          WithdrawAllInCategory(player, subclass);
+        sReagentBankEngine->WithdrawAllReagents(bags);
       }
       else
       {
         // Category menu: withdraw only this category
-        WithdrawAllInCategory(player, gossipPageNumber);
+        sReagentBankEngine->WithdrawAllInCategory(bags, gossipPageNumber);
       }
       CloseGossipMenuFor(player);
       return true;
@@ -800,6 +474,33 @@ public:
       OnGossipHello(player, creature);
       return true;
     }
+    else if (item_subclass == TRANSACTION_HISTORY)
+    {
+      ShowTransactionHistory(player, creature);
+      return true;
+    }
+    else if (item_subclass == GUILD_REAGENTS ||
+             item_subclass == GUILD_DEPOSIT_ALL_REAGENTS ||
+             item_subclass == ACTION_GUILD_WITHDRAW_STACK)
+    {
+      // Guild menu, pageless actions go back to its first page
+      if (!sReagentBankGuild->IsEnabled() || !player->GetGuildId())
+      {
+        OnGossipHello(player, creature);
+        return true;
+      }
+      if (item_subclass == GUILD_DEPOSIT_ALL_REAGENTS)
+        DepositAllReagentsToGuild(player);
+      else if (item_subclass == ACTION_GUILD_WITHDRAW_STACK)
+      {
+        // Shows the page itself once the withdraw is back
+        WithdrawGuildStack(player, creature, gossipPageNumber);
+        return true;
+      }
+      ShowGuildReagents(player, creature,
+                        item_subclass == GUILD_REAGENTS ? gossipPageNumber : 0);
+      return true;
+    }
     else if (IsCategory(item_subclass))
     {
       // A category was selected (or changing pages inside it)
@@ -822,16 +523,29 @@ public:
           category = it->second.first;
           pageIndex = it->second.second;
         }
+        // The page is shown again once the withdraw committed
+        ObjectGuid playerGuid = player->GetGUID();
+        ObjectGuid bankerGuid = creature->GetGUID();
+        auto showPage = [=, this]()
+        {
+          Player *withdrawer = ObjectAccessor::FindConnectedPlayer(playerGuid);
+          if (!withdrawer)
+            return;
+          Creature *banker = ObjectAccessor::GetCreature(*withdrawer, bankerGuid);
+          if (!banker)
+            return;
+          if (IsCategory(category))
+            ShowReagentItems(withdrawer, banker, category, pageIndex);
+          else
+            OnGossipHello(withdrawer, banker);
+        };
+        auto bags = std::make_shared<ReagentBankPlayerBags>(player);
         if (item_subclass == ACTION_WITHDRAW_ONE)
-          WithdrawOne(player, itemEntry);
+          sReagentBankEngine->WithdrawOne(bags, itemEntry, showPage);
         else if (item_subclass == ACTION_WITHDRAW_STACK)
-          WithdrawStack(player, itemEntry);
+          sReagentBankEngine->WithdrawStack(bags, itemEntry, showPage);
         else if (item_subclass == ACTION_WITHDRAW_ALL)
-          WithdrawAllOfItem(player, itemEntry);
-        if (IsCategory(category))
-          ShowReagentItems(player, creature, category, pageIndex);
-        else
-          OnGossipHello(player, creature);
+          sReagentBankEngine->WithdrawAllOfItem(bags, itemEntry, showPage);
         return true;
       }
       // Otherwise treat it as an item entry -> show submenu
@@ -842,35 +556,197 @@ public:
         OnGossipHello(player, creature);
         return true;
       }
-      uint32 cat = (temp->Class == ITEM_CLASS_GEM) ? ITEM_SUBCLASS_JEWELCRAFTING : temp->SubClass;
+      uint32 cat = GetReagentBankCategory(itemEntry);
       m_lastCategoryPage[guidLow] = {cat, (uint16)gossipPageNumber};
       ShowItemWithdrawMenu(player, creature, cat, (uint16)gossipPageNumber, itemEntry);
       return true;
     }
   }
 
+  // Search box: lists the stored reagents matching the entered name
+  bool OnGossipSelectCode(Player *player, Creature *creature, uint32 sender,
+                          uint32 /*action*/, char const *code) override
+  {
+    player->PlayerTalkClass->ClearMenus();
+    if (sender != SEARCH_REAGENTS || !code || !*code)
+    {
+      OnGossipHello(player, creature);
+      return true;
+    }
+    uint32 guidLow = player->GetGUID().GetCounter();
+    if (!sReagentBankThrottle->Allow(guidLow))
+    {
+      ChatHandler(player->GetSession())
+          .SendSysMessage("The reagent banker is busy, please slow down.");
+      CloseGossipMenuFor(player);
+      return true;
+    }
+    std::string searchText(code);
+    ObjectGuid bankerGuid = creature->GetGUID();
+    uint32 generation = sReagentBankThrottle->BeginRender(guidLow);
+    sReagentBankLedger->LoadAsync(
+        player, [=, this](ReagentBankItemMap const &items)
+        {
+          if (!sReagentBankThrottle->IsLatestRender(guidLow, generation))
+            return;
+          // The banker may be gone by the time the load is back
+          Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid);
+          if (!banker)
+            return;
+          constexpr int ICON_SIZE = 18;
+          constexpr int ICON_X = 0;
+          constexpr int ICON_Y = 0;
+          constexpr int GOSSIP_ICON_NONE = 0;
+
+          std::vector<std::pair<uint32, uint32>> found =
+              sReagentBankSearchIndex->FindStored(items, searchText,
+                                                  MAX_SEARCH_RESULTS);
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, "|cff003366Search \"" + searchText + "\": " + std::to_string(found.size()) + " found|r", 0, 0);
+          for (std::pair<uint32, uint32> const &match : found)
+          {
+            std::string link = GetItemLink(match.first, player->GetSession());
+            std::string icon = GetCachedItemIcon(match.first, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y);
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, icon + link + " |cff000000x " + std::to_string(match.second) + "|r", match.first, 0);
+          }
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(6948, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff666666Back to Categories|r", MAIN_MENU, 0);
+          SendGossipMenuFor(player, NPC_TEXT_ID, banker->GetGUID());
+        });
+    return true;
+  }
+
+  static std::string FormatAge(time_t seconds)
+  {
+    if (seconds >= DAY)
+      return std::to_string(seconds / DAY) + "d";
+    if (seconds >= HOUR)
+      return std::to_string(seconds / HOUR) + "h";
+    if (seconds >= MINUTE)
+      return std::to_string(seconds / MINUTE) + "m";
+    return std::to_string(std::max<time_t>(seconds, 0)) + "s";
+  }
+
+  // Shows the latest changes to the player's bank, newest first
+  void ShowTransactionHistory(Player *player, Creature *creature)
+  {
+    uint32 guidLow = player->GetGUID().GetCounter();
+    ObjectGuid bankerGuid = creature->GetGUID();
+    uint32 generation = sReagentBankThrottle->BeginRender(guidLow);
+    sReagentBankAudit->LoadHistoryAsync(
+        player, GetReagentBankOwner(player),
+        [=, this](std::vector<ReagentBankAuditEntry> const &entries)
+        {
+          if (!sReagentBankThrottle->IsLatestRender(guidLow, generation))
+            return;
+          // The banker may be gone by the time the load is back
+          Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid);
+          if (!banker)
+            return;
+          constexpr int ICON_SIZE = 18;
+          constexpr int ICON_X = 0;
+          constexpr int ICON_Y = 0;
+          constexpr int GOSSIP_ICON_NONE = 0;
+
+          time_t now = GameTime::GetGameTime().count();
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, "|cff003366Recent Transactions|r", TRANSACTION_HISTORY, 0);
+          if (entries.empty())
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, "|cff000000Nothing yet|r", TRANSACTION_HISTORY, 0);
+          for (ReagentBankAuditEntry const &entry : entries)
+          {
+            std::string line = GetCachedItemIcon(entry.entry, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) +
+                               GetItemLink(entry.entry, player->GetSession()) +
+                               (entry.delta > 0 ? " |cff1eff00+" : " |cffff2020") + std::to_string(entry.delta) + "|r";
+            if (entry.amountAfter != AUDIT_AMOUNT_UNKNOWN)
+              line += " |cff000000(" + std::to_string(entry.amountAfter) + ")|r";
+            line += " |cff666666" + std::string(GetReagentBankAuditOperationName(entry.operation)) + ", " +
+                    FormatAge(now - entry.time) + " ago|r";
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, line, TRANSACTION_HISTORY, 0);
+          }
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(6948, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff666666Back to Categories|r", MAIN_MENU, 0);
+          SendGossipMenuFor(player, NPC_TEXT_ID, banker->GetGUID());
+        });
+  }
+
+  // Shows the reagents of the player's guild, with pagination
+  void ShowGuildReagents(Player *player, Creature *creature,
+                         uint16 gossipPageNumber)
+  {
+    uint32 guidLow = player->GetGUID().GetCounter();
+    uint32 generation = sReagentBankThrottle->BeginRender(guidLow);
+    bool canWithdraw = sReagentBankGuild->CanWithdraw(player);
+    ObjectGuid bankerGuid = creature->GetGUID();
+    sReagentBankGuild->LoadAsync(
+        player, [=, this](ReagentBankItemMap const &items, uint32 deposited,
+                          uint32 withdrawn)
+        {
+          if (!sReagentBankThrottle->IsLatestRender(guidLow, generation))
+            return;
+          // The banker may be gone by the time the load is back
+          Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid);
+          if (!banker)
+            return;
+          constexpr int ICON_SIZE = 18;
+          constexpr int ICON_X = 0;
+          constexpr int ICON_Y = 0;
+          constexpr int GOSSIP_ICON_NONE = 0;
+
+          uint32 totalPages = items.empty() ? 1 : ((items.size() - 1) / g_maxOptionsPerPage) + 1;
+          uint32 page = std::min<uint32>(gossipPageNumber, totalPages - 1);
+
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, "|cff003366Guild Reagents: " + std::to_string(items.size()) + " types|r", GUILD_REAGENTS, page);
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, "|cff000000You deposited " + std::to_string(deposited) + ", withdrew " + std::to_string(withdrawn) + "|r", GUILD_REAGENTS, page);
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(2901, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff1eff00Deposit All|r", GUILD_DEPOSIT_ALL_REAGENTS, 0);
+          if (page + 1 < totalPages)
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(23705, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff003366Next Page|r ▶ (" + std::to_string(page + 2) + "/" + std::to_string(totalPages) + ")", GUILD_REAGENTS, page + 1);
+          if (page > 0)
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, "◀ |cff003366Previous Page|r " + GetCachedItemIcon(23705, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " (" + std::to_string(page) + "/" + std::to_string(totalPages) + ")", GUILD_REAGENTS, page - 1);
+
+          // Newest entries first, like the category pages; clicking an
+          // entry withdraws a stack
+          uint32 index = 0;
+          for (auto it = items.rbegin(); it != items.rend(); ++it, ++index)
+          {
+            if (index < page * g_maxOptionsPerPage)
+              continue;
+            if (index >= (page + 1) * g_maxOptionsPerPage)
+              break;
+            std::string link = GetItemLink(it->first, player->GetSession());
+            std::string icon = GetCachedItemIcon(it->first, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y);
+            AddGossipItemFor(player, GOSSIP_ICON_NONE, icon + link + " |cff000000x " + std::to_string(it->second.amount) + "|r",
+                             canWithdraw ? ACTION_GUILD_WITHDRAW_STACK : GUILD_REAGENTS,
+                             canWithdraw ? it->first : page);
+          }
+          AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(6948, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff666666Back to Categories|r", MAIN_MENU, 0);
+          SendGossipMenuFor(player, NPC_TEXT_ID, banker->GetGUID());
+        });
+  }
+
   // Shows the list of stored reagents for a category, with pagination
   void ShowReagentItems(Player *player, Creature *creature,
                         uint32 item_subclass, uint16 gossipPageNumber)
   {
     WorldSession *session = player->GetSession();
-    uint32 accountKey, guidKey;
-    GetStorageKeys(player, accountKey, guidKey);
-    std::string query = "SELECT item_entry, amount FROM mod_reagent_bank_account WHERE account_id = " + std::to_string(accountKey) + " AND guid = " + std::to_string(guidKey) + " AND item_subclass = " + std::to_string(item_subclass) + " ORDER BY item_entry DESC";
-    session->GetQueryProcessor().AddCallback(CharacterDatabase.AsyncQuery(query).WithCallback([=, this](QueryResult result)
-                                                                                              {
-      // Build arrays first
+    // Page flips supersede renders still waiting for their load
+    uint32 guidLow = player->GetGUID().GetCounter();
+    uint32 generation = sReagentBankThrottle->BeginRender(guidLow);
+    ObjectGuid bankerGuid = creature->GetGUID();
+    sReagentBankLedger->LoadAsync(player, [=, this](ReagentBankItemMap const &items)
+                                  {
+      if (!sReagentBankThrottle->IsLatestRender(guidLow, generation))
+        return;
+      // The banker may be gone by the time the load is back
+      Creature *banker = ObjectAccessor::GetCreature(*player, bankerGuid);
+      if (!banker)
+        return;
+      // Build arrays first, newest entries first
       std::map<uint32, uint32> entryToAmountMap;
       std::vector<uint32> itemEntries;
       uint32 totalAmount = 0;
-      if (result) {
-        do {
-          uint32 itemEntry = (*result)[0].Get<uint32>();
-          uint32 itemAmount = (*result)[1].Get<uint32>();
-          entryToAmountMap[itemEntry] = itemAmount;
-          itemEntries.push_back(itemEntry);
-          totalAmount += itemAmount;
-        } while (result->NextRow());
+      for (auto it = items.rbegin(); it != items.rend(); ++it) {
+        if (GetReagentBankCategory(it->first) != item_subclass)
+          continue;
+        entryToAmountMap[it->first] = it->second.amount;
+        itemEntries.push_back(it->first);
+        totalAmount += it->second.amount;
       }
 
       uint32 totalItems = itemEntries.size();
@@ -883,26 +759,7 @@ public:
       uint32 currentPage = clampedPageIndex + 1;
       uint32 effectivePageNumber = clampedPageIndex;
 
-      // Category name
-      std::string categoryName;
-      switch (item_subclass) {
-      case ITEM_SUBCLASS_CLOTH: categoryName = "Cloth"; break;
-      case ITEM_SUBCLASS_MEAT: categoryName = "Meat"; break;
-      case ITEM_SUBCLASS_METAL_STONE: categoryName = "Metal & Stone"; break;
-      case ITEM_SUBCLASS_ENCHANTING: categoryName = "Enchanting"; break;
-      case ITEM_SUBCLASS_ELEMENTAL: categoryName = "Elemental"; break;
-      case ITEM_SUBCLASS_PARTS: categoryName = "Parts"; break;
-      case ITEM_SUBCLASS_TRADE_GOODS_OTHER: categoryName = "Other Trade Goods"; break;
-      case ITEM_SUBCLASS_HERB: categoryName = "Herb"; break;
-      case ITEM_SUBCLASS_LEATHER: categoryName = "Leather"; break;
-      case ITEM_SUBCLASS_JEWELCRAFTING: categoryName = "Jewelcrafting"; break;
-      case ITEM_SUBCLASS_EXPLOSIVES: categoryName = "Explosives"; break;
-      case ITEM_SUBCLASS_DEVICES: categoryName = "Devices"; break;
-      case ITEM_SUBCLASS_MATERIAL: categoryName = "Nether Material"; break;
-      case ITEM_SUBCLASS_ARMOR_ENCHANTMENT: categoryName = "Armor Vellum"; break;
-      case ITEM_SUBCLASS_WEAPON_ENCHANTMENT: categoryName = "Weapon Vellum"; break;
-      default: categoryName = "Reagents"; break;
-      }
+      std::string categoryName = GetReagentBankCategoryName(item_subclass);
 
       constexpr int ICON_SIZE = 18;
       constexpr int ICON_X = 0;
@@ -910,7 +767,9 @@ public:
       constexpr int GOSSIP_ICON_NONE = 0;
 
       AddGossipItemFor(player, GOSSIP_ICON_NONE, "|cff003366" + categoryName + ": " + std::to_string(totalItems) + " types, " + std::to_string(totalAmount) + " total|r", 0, 0);
-      AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(2901, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff1eff00Deposit All|r", DEPOSIT_ALL_REAGENTS, item_subclass);
+      // Nothing can be deposited to the uncategorized reagents
+      if (item_subclass != UNCATEGORIZED_REAGENT_BANK_CATEGORY)
+        AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(2901, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff1eff00Deposit All|r", DEPOSIT_ALL_REAGENTS, item_subclass);
       AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(2901, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff0070ddWithdraw All|r", WITHDRAW_ALL_REAGENTS, item_subclass);
 
       if (endValue < entryToAmountMap.size()) {
@@ -931,9 +790,84 @@ public:
       }
 
       AddGossipItemFor(player, GOSSIP_ICON_NONE, GetCachedItemIcon(6948, ICON_SIZE, ICON_SIZE, ICON_X, ICON_Y) + " |cff666666Back to Categories|r", MAIN_MENU, 0);
-      SendGossipMenuFor(player, NPC_TEXT_ID, creature->GetGUID()); }));
+      SendGossipMenuFor(player, NPC_TEXT_ID, banker->GetGUID()); });
+  }
+};
+
+// Drops the per-player state when its owner leaves
+class mod_reagent_bank_account_player : public PlayerScript
+{
+public:
+  mod_reagent_bank_account_player()
+      : PlayerScript("mod_reagent_bank_account_player")
+  {
+  }
+
+  void OnPlayerLogout(Player *player) override
+  {
+    sReagentBankLedger->Unload(GetReagentBankOwner(player));
+    sReagentBankAudit->Unload(GetReagentBankOwner(player));
+    sReagentBankThrottle->RemovePlayer(player->GetGUID().GetCounter());
+  }
+};
+
+// Opens the bank's DB connections, replays the journal and builds the name
+// search index on startup, drives the deposit commits, the journal, the
+// guild merges and the benchmark, and prunes old operation tokens
+class mod_reagent_bank_account_world : public WorldScript
+{
+private:
+  uint32 m_pruneTimer = 0;
+
+public:
+  mod_reagent_bank_account_world()
+      : WorldScript("mod_reagent_bank_account_world")
+  {
+  }
+
+  void OnStartup() override
+  {
+    sReagentBankDatabasePool->Open();
+    sReagentBankLedger->Initialize();
+    // The search index only takes items of a category
+    sReagentBankCategories->Load();
+    // Deposits lost in a crash are back before anyone can use the bank
+    sReagentBankJournal->Replay();
+    // After the replay, which writes in the format the journal was written in
+    sReagentBankLedger->ConvertStorage();
+    sReagentBankSearchIndex->Build();
+  }
+
+  void OnShutdown() override
+  {
+    sReagentBankJournal->Flush();
+    sReagentBankAudit->Flush(true);
+    sReagentBankAnalytics->Shutdown();
+    sReagentBankBenchmark->Shutdown();
+    sReagentBankDatabasePool->Close();
+  }
+
+  void OnUpdate(uint32 diff) override
+  {
+    sReagentBankDatabasePool->Update();
+    sReagentBankLedger->Update(diff);
+    sReagentBankJournal->Update(diff);
+    sReagentBankGuild->Update(diff);
+    sReagentBankAudit->Update(diff);
+    sReagentBankBenchmark->Update();
+
+    m_pruneTimer += diff;
+    if (m_pruneTimer < HOUR * IN_MILLISECONDS)
+      return;
+    m_pruneTimer = 0;
+    sReagentBankLedger->PruneOperations();
   }
 };
 
 // Add all scripts in one
-void AddSC_mod_reagent_bank_account() { new mod_reagent_bank_account(); }
+void AddSC_mod_reagent_bank_account()
+{
+  new mod_reagent_bank_account();
+  new mod_reagent_bank_account_player();
+  new mod_reagent_bank_account_world();
+}
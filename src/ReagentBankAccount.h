@@ -4,7 +4,9 @@
 #include "Config.h"
 #include "Item.h"
 #include "ItemTemplate.h"
+#include "ObjectMgr.h"
 #include "Player.h"
+#include "ReagentBankCategory.h"
 #include "ScriptMgr.h"
 #include "ScriptedCreature.h"
 #include "ScriptedGossip.h"
@@ -13,14 +15,51 @@
 #define DEFAULT_MAX_OPTIONS 7
 #define MAX_PAGE_NUMBER 700 // Values higher than this are considered Item IDs
 #define NPC_TEXT_ID 4259    // Pre-existing NPC text
+#define MAX_SEARCH_RESULTS 20
 
+// Gossip senders below MAX_REAGENT_BANK_CATEGORIES are categories
 enum GossipItemType : uint8 {
-  DEPOSIT_ALL_REAGENTS = 16,
-  MAIN_MENU = 17,
-  WITHDRAW_ALL_REAGENTS = 102
+  DEPOSIT_ALL_REAGENTS = 200,
+  MAIN_MENU = 201,
+  SEARCH_REAGENTS = 202,
+  GUILD_REAGENTS = 203,
+  GUILD_DEPOSIT_ALL_REAGENTS = 204,
+  WITHDRAW_ALL_REAGENTS = 205,
+  TRANSACTION_HISTORY = 206
 };
 
 extern uint32 g_maxOptionsPerPage;
 extern bool g_accountWideReagentBank;
 
+std::string GetReagentBankItemLink(uint32 entry, WorldSession *session);
+std::string GetReagentBankCategoryName(uint32 category);
+
+// Only items of a category can be stored, and unique items are skipped
+inline bool IsReagentBankItem(ItemTemplate const *itemTemplate)
+{
+  return itemTemplate &&
+         sReagentBankCategories->GetCategory(itemTemplate) !=
+             NO_REAGENT_BANK_CATEGORY &&
+         itemTemplate->GetMaxStackSize() > 1;
+}
+
+inline uint32 GetReagentBankCategory(ItemTemplate const *itemTemplate)
+{
+  return sReagentBankCategories->GetCategory(itemTemplate);
+}
+
+// Stored items are classified by their template, not by the category
+// stored with them, so a changed category table applies to them as well.
+// Those it no longer takes are uncategorized.
+inline uint32 GetReagentBankCategory(uint32 entry)
+{
+  ItemTemplate const *itemTemplate = sObjectMgr->GetItemTemplate(entry);
+  if (!itemTemplate)
+    return NO_REAGENT_BANK_CATEGORY;
+  uint32 category = GetReagentBankCategory(itemTemplate);
+  return category != NO_REAGENT_BANK_CATEGORY
+             ? category
+             : UNCATEGORIZED_REAGENT_BANK_CATEGORY;
+}
+
 #endif // AZEROTHCORE_REAGENTBANKACCOUNT_H
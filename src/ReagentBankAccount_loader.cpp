@@ -1,7 +1,9 @@
 // From SC
 void AddSC_mod_reagent_bank_account();
+void AddSC_mod_reagent_bank_account_commands();
 
 void Addmod_reagent_bank_accountScripts()
 {
     AddSC_mod_reagent_bank_account();
+    AddSC_mod_reagent_bank_account_commands();
 }
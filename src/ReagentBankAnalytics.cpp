@@ -0,0 +1,177 @@
+#include "ReagentBankAnalytics.h"
+#include "Config.h"
+#include "GameTime.h"
+#include "Log.h"
+#include "ReagentBankAccount.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankPacked.h"
+#include "Timer.h"
+#include <algorithm>
+#include <chrono>
+
+ReagentBankAnalytics *ReagentBankAnalytics::instance()
+{
+  static ReagentBankAnalytics instance;
+  return &instance;
+}
+
+void ReagentBankAnalytics::LoadConfig()
+{
+  m_maxAge = sConfigMgr->GetOption<uint32>("ReagentBankAccount.Analytics.MaxAge",
+                                           DEFAULT_ANALYTICS_MAX_AGE);
+}
+
+std::shared_ptr<ReagentBankSnapshot const>
+ReagentBankAnalytics::GetSnapshot() const
+{
+  std::lock_guard<std::mutex> guard(m_lock);
+  return m_snapshot;
+}
+
+bool ReagentBankAnalytics::IsStale(ReagentBankSnapshot const &snapshot) const
+{
+  return GameTime::GetGameTime().count() - snapshot.time > time_t(m_maxAge);
+}
+
+bool ReagentBankAnalytics::Refresh()
+{
+  if (m_running.exchange(true))
+    return false;
+  // The previous run has finished, m_running was cleared
+  if (m_thread.joinable())
+    m_thread.join();
+
+  // The storage format and the game time are the world thread's, read them
+  // here
+  ReagentBankStorageFormat storage = sReagentBankLedger->GetStorageFormat();
+  time_t time = GameTime::GetGameTime().count();
+  m_thread = std::thread(
+      [this, storage, time]()
+      {
+        uint32 startTime = getMSTime();
+        auto snapshot = std::make_shared<ReagentBankSnapshot>();
+        snapshot->time = time;
+        Compute(storage, *snapshot);
+        LOG_INFO("module", "Reagent bank snapshot of {} banks computed in {} ms",
+                 snapshot->banks, GetMSTimeDiffToNow(startTime));
+        {
+          std::lock_guard<std::mutex> guard(m_lock);
+          m_snapshot = snapshot;
+        }
+        m_running = false;
+      });
+  return true;
+}
+
+void ReagentBankAnalytics::Shutdown()
+{
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+void ReagentBankAnalytics::Add(ReagentBankSnapshot &snapshot,
+                               ReagentBankOwner const &owner, uint32 entry,
+                               uint32 amount)
+{
+  snapshot.totals[entry] += amount;
+  // Classified like the banker menu does, by the current category table;
+  // what it no longer takes is uncategorized there as well
+  uint32 category = GetReagentBankCategory(entry);
+  snapshot.categories[category != NO_REAGENT_BANK_CATEGORY
+                          ? category
+                          : UNCATEGORIZED_REAGENT_BANK_CATEGORY] += amount;
+
+  // Kept sorted, largest first
+  std::vector<ReagentBankSnapshot::Holder> &holders = snapshot.topHolders[entry];
+  if (holders.size() == ANALYTICS_TOP_HOLDERS)
+  {
+    if (holders.back().amount >= amount)
+      return;
+    holders.pop_back();
+  }
+  auto position = std::find_if(
+      holders.begin(), holders.end(),
+      [amount](ReagentBankSnapshot::Holder const &holder)
+      { return holder.amount < amount; });
+  holders.insert(position, {owner, amount});
+}
+
+void ReagentBankAnalytics::Compute(ReagentBankStorageFormat storage,
+                                   ReagentBankSnapshot &snapshot)
+{
+  auto pause = []()
+  {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(ANALYTICS_CHUNK_PAUSE_MS));
+  };
+
+  // Personal banks, keyset pagination over the primary key
+  ReagentBankOwner owner;
+  if (storage == REAGENT_BANK_STORAGE_PACKED)
+  {
+    while (QueryResult result = ReagentBankAnalyticsDatabase.Query(
+               "SELECT account_id, guid, data FROM mod_reagent_bank_account_packed WHERE (account_id, guid) > ({}, {}) ORDER BY account_id, guid LIMIT {}",
+               owner.accountId, owner.guid, ANALYTICS_CHUNK_ROWS))
+    {
+      do
+      {
+        Field *fields = result->Fetch();
+        owner.accountId = fields[0].Get<uint32>();
+        owner.guid = fields[1].Get<uint32>();
+        ReagentBankItemMap items;
+        if (!DecodeReagentBank(fields[2].Get<Binary>(), items))
+          continue;
+        ++snapshot.banks;
+        for (auto const &itr : items)
+          Add(snapshot, owner, itr.first, itr.second.amount);
+      } while (result->NextRow());
+      pause();
+    }
+  }
+  else
+  {
+    uint32 lastEntry = 0;
+    bool hasOwner = false;
+    while (QueryResult result = ReagentBankAnalyticsDatabase.Query(
+               "SELECT account_id, guid, item_entry, amount FROM mod_reagent_bank_account WHERE (account_id, guid, item_entry) > ({}, {}, {}) ORDER BY account_id, guid, item_entry LIMIT {}",
+               owner.accountId, owner.guid, lastEntry, ANALYTICS_CHUNK_ROWS))
+    {
+      do
+      {
+        Field *fields = result->Fetch();
+        uint32 accountId = fields[0].Get<uint32>();
+        uint32 guid = fields[1].Get<uint32>();
+        if (!hasOwner || accountId != owner.accountId || guid != owner.guid)
+        {
+          ++snapshot.banks;
+          hasOwner = true;
+        }
+        owner.accountId = accountId;
+        owner.guid = guid;
+        lastEntry = fields[2].Get<uint32>();
+        Add(snapshot, owner, lastEntry, fields[3].Get<uint32>());
+      } while (result->NextRow());
+      pause();
+    }
+  }
+
+  // Guild banks
+  ReagentBankOwner guild;
+  uint32 lastEntry = 0;
+  while (QueryResult result = ReagentBankAnalyticsDatabase.Query(
+             "SELECT guild_id, item_entry, amount FROM mod_reagent_bank_account_guild WHERE (guild_id, item_entry) > ({}, {}) ORDER BY guild_id, item_entry LIMIT {}",
+             guild.guildId, lastEntry, ANALYTICS_CHUNK_ROWS))
+  {
+    do
+    {
+      Field *fields = result->Fetch();
+      uint32 guildId = fields[0].Get<uint32>();
+      if (guildId != guild.guildId)
+        ++snapshot.banks;
+      guild.guildId = guildId;
+      lastEntry = fields[1].Get<uint32>();
+      Add(snapshot, guild, lastEntry, fields[2].Get<uint32>());
+    } while (result->NextRow());
+    pause();
+  }
+}
@@ -0,0 +1,77 @@
+#ifndef AZEROTHCORE_REAGENTBANKANALYTICS_H
+#define AZEROTHCORE_REAGENTBANKANALYTICS_H
+#include "ReagentBankLedger.h"
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define ANALYTICS_CHUNK_ROWS 5000
+#define ANALYTICS_CHUNK_PAUSE_MS 10
+#define ANALYTICS_TOP_HOLDERS 10
+#define DEFAULT_ANALYTICS_MAX_AGE 600
+
+// Server-wide totals of everything stored in the reagent banks, guild
+// banks included (merged amounts only)
+struct ReagentBankSnapshot
+{
+  struct Holder
+  {
+    ReagentBankOwner owner;
+    uint32 amount;
+  };
+
+  // When the scan started
+  time_t time = 0;
+  uint32 banks = 0;
+  // item entry -> total amount
+  std::unordered_map<uint32, uint64> totals;
+  // item entry -> largest holders, largest first
+  std::unordered_map<uint32, std::vector<Holder>> topHolders;
+  // category -> total amount
+  std::map<uint32, uint64> categories;
+};
+
+// Computes ReagentBankSnapshot on a background thread from a chunked scan
+// of the bank tables over a DB connection of its own, so the economy
+// commands never run aggregates that compete with the banker's own
+// queries. Each chunk is a short, non-locking read; the snapshot is
+// therefore not a single point in time but close to one. There is no
+// schedule: a command finding the snapshot older than MaxAge starts the
+// next one, and the last snapshot is kept until the next one completes.
+class ReagentBankAnalytics
+{
+public:
+  static ReagentBankAnalytics *instance();
+
+  void LoadConfig();
+
+  // nullptr until the first snapshot completes
+  std::shared_ptr<ReagentBankSnapshot const> GetSnapshot() const;
+  bool IsStale(ReagentBankSnapshot const &snapshot) const;
+  bool IsRunning() const { return m_running; }
+  // Starts computing a new snapshot, false when one is already running
+  bool Refresh();
+  void Shutdown();
+
+private:
+  static void Compute(ReagentBankStorageFormat storage,
+                      ReagentBankSnapshot &snapshot);
+  static void Add(ReagentBankSnapshot &snapshot, ReagentBankOwner const &owner,
+                  uint32 entry, uint32 amount);
+
+  uint32 m_maxAge = DEFAULT_ANALYTICS_MAX_AGE;
+
+  mutable std::mutex m_lock;
+  std::shared_ptr<ReagentBankSnapshot const> m_snapshot;
+  std::atomic<bool> m_running{false};
+  std::thread m_thread;
+};
+
+#define sReagentBankAnalytics ReagentBankAnalytics::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKANALYTICS_H
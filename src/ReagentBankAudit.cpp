@@ -0,0 +1,210 @@
+#include "ReagentBankAudit.h"
+#include "Config.h"
+#include "DatabaseEnv.h"
+#include "GameTime.h"
+#include "ReagentBankDatabase.h"
+#include "Timer.h"
+#include <algorithm>
+#include <sstream>
+
+char const *GetReagentBankAuditOperationName(ReagentBankAuditOperation operation)
+{
+  switch (operation)
+  {
+  case AUDIT_DEPOSIT: return "deposit";
+  case AUDIT_WITHDRAW: return "withdraw";
+  case AUDIT_REFUND: return "refund";
+  case AUDIT_REPLAY: return "recovered";
+  case AUDIT_GUILD_DEPOSIT: return "guild deposit";
+  case AUDIT_GUILD_WITHDRAW: return "guild withdraw";
+  default: return "unknown";
+  }
+}
+
+ReagentBankAudit *ReagentBankAudit::instance()
+{
+  static ReagentBankAudit instance;
+  return &instance;
+}
+
+void ReagentBankAudit::LoadConfig()
+{
+  m_enabled =
+      sConfigMgr->GetOption<bool>("ReagentBankAccount.Audit.Enable", true);
+  m_flushInterval = sConfigMgr->GetOption<uint32>(
+      "ReagentBankAccount.Audit.FlushInterval", DEFAULT_AUDIT_FLUSH_INTERVAL);
+  m_historySize = std::max<uint32>(
+      1, sConfigMgr->GetOption<uint32>("ReagentBankAccount.Audit.HistorySize",
+                                       DEFAULT_AUDIT_HISTORY_SIZE));
+}
+
+void ReagentBankAudit::History::Push(ReagentBankAuditEntry const &entry,
+                                     size_t capacity)
+{
+  if (entries.size() < capacity)
+  {
+    entries.push_back(entry);
+    return;
+  }
+  entries[next] = entry;
+  next = (next + 1) % capacity;
+}
+
+std::vector<ReagentBankAuditEntry>
+ReagentBankAudit::History::GetNewestFirst() const
+{
+  // Oldest entry is at next once the buffer wrapped, at 0 before
+  std::vector<ReagentBankAuditEntry> result;
+  result.reserve(entries.size());
+  for (size_t i = 0; i < entries.size(); ++i)
+    result.push_back(
+        entries[(next + entries.size() - 1 - i) % entries.size()]);
+  return result;
+}
+
+void ReagentBankAudit::Record(ReagentBankOwner const &owner, uint32 character,
+                              uint32 entry, int32 delta, int64 amountAfter,
+                              ReagentBankAuditOperation operation)
+{
+  if (!m_enabled)
+    return;
+  ReagentBankAuditEntry auditEntry{GameTime::GetGameTime().count(), character,
+                                   entry, delta, amountAfter, operation};
+  m_histories[owner.GetKey()].Push(auditEntry, m_historySize);
+  m_pending.push_back({owner, auditEntry});
+}
+
+void ReagentBankAudit::Record(
+    ReagentBankOwner const &owner, uint32 character,
+    std::vector<ReagentBankItemAmount> const &amounts,
+    ReagentBankAuditOperation operation)
+{
+  bool withdrawn =
+      operation == AUDIT_WITHDRAW || operation == AUDIT_GUILD_WITHDRAW;
+  ReagentBankItemMap const *items = sReagentBankLedger->GetItems(owner);
+  for (ReagentBankItemAmount const &amount : amounts)
+  {
+    int64 amountAfter = AUDIT_AMOUNT_UNKNOWN;
+    if (items)
+    {
+      auto it = items->find(amount.entry);
+      amountAfter = it != items->end() ? it->second.amount : 0;
+    }
+    Record(owner, character, amount.entry,
+           withdrawn ? -int32(amount.amount) : int32(amount.amount),
+           amountAfter, operation);
+  }
+}
+
+void ReagentBankAudit::LoadHistoryAsync(
+    Player *player, ReagentBankOwner const &owner,
+    std::function<void(std::vector<ReagentBankAuditEntry> const &)> callback)
+{
+  uint64 key = owner.GetKey();
+  auto it = m_histories.find(key);
+  if (it != m_histories.end())
+  {
+    callback(it->second.GetNewestFirst());
+    return;
+  }
+  player->GetSession()->GetQueryProcessor().AddCallback(
+      ReagentBankDatabase.AsyncQuery(
+          "SELECT time, character_guid, item_entry, delta, amount_after, operation FROM mod_reagent_bank_account_log WHERE account_id = " + std::to_string(owner.accountId) + " AND guid = " + std::to_string(owner.guildId ? 0 : owner.guid) + " AND guild_id = " + std::to_string(owner.guildId) + " ORDER BY id DESC LIMIT " + std::to_string(m_historySize))
+          .WithCallback(
+              [=, this](QueryResult result)
+              {
+                std::vector<ReagentBankAuditEntry> stored;
+                if (result)
+                {
+                  do
+                  {
+                    Field *fields = result->Fetch();
+                    stored.push_back(
+                        {time_t(fields[0].Get<uint32>()),
+                         fields[1].Get<uint32>(), fields[2].Get<uint32>(),
+                         fields[3].Get<int32>(),
+                         fields[4].IsNull() ? AUDIT_AMOUNT_UNKNOWN
+                                            : int64(fields[4].Get<uint32>()),
+                         ReagentBankAuditOperation(fields[5].Get<uint8>())});
+                  } while (result->NextRow());
+                }
+                // Whatever was recorded while the query ran is newer
+                History history;
+                for (auto row = stored.rbegin(); row != stored.rend(); ++row)
+                  history.Push(*row, m_historySize);
+                auto recorded = m_histories.find(key);
+                if (recorded != m_histories.end())
+                {
+                  std::vector<ReagentBankAuditEntry> newer =
+                      recorded->second.GetNewestFirst();
+                  for (auto entry = newer.rbegin(); entry != newer.rend();
+                       ++entry)
+                    history.Push(*entry, m_historySize);
+                }
+                History &kept = m_histories[key];
+                kept = std::move(history);
+                callback(kept.GetNewestFirst());
+              }));
+}
+
+void ReagentBankAudit::Unload(ReagentBankOwner const &owner)
+{
+  m_histories.erase(owner.GetKey());
+  // A history read right after relogging should find these
+  Flush();
+}
+
+void ReagentBankAudit::Update(uint32 diff)
+{
+  m_commitCallbacks.ProcessReadyCallbacks();
+  m_timer += diff;
+  if (m_timer < m_flushInterval)
+    return;
+  m_timer = 0;
+  Flush();
+}
+
+void ReagentBankAudit::Flush(bool wait)
+{
+  if (m_pending.empty())
+    return;
+  // Kept in memory until the bank's DB queue drained
+  if (!wait && sReagentBankDatabasePool->IsBusy())
+    return;
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  for (size_t start = 0; start < m_pending.size();
+       start += AUDIT_ROWS_PER_INSERT)
+  {
+    std::ostringstream sql;
+    sql << "INSERT INTO mod_reagent_bank_account_log (account_id, guid, guild_id, character_guid, item_entry, delta, amount_after, operation, time) VALUES ";
+    size_t end = std::min(m_pending.size(), start + AUDIT_ROWS_PER_INSERT);
+    for (size_t i = start; i < end; ++i)
+    {
+      PendingRow const &row = m_pending[i];
+      // The member of a guild bank is the character column
+      sql << (i > start ? ", (" : "(") << row.owner.accountId << ", "
+          << (row.owner.guildId ? 0 : row.owner.guid) << ", "
+          << row.owner.guildId << ", "
+          << row.entry.character << ", " << row.entry.entry << ", "
+          << row.entry.delta << ", ";
+      if (row.entry.amountAfter == AUDIT_AMOUNT_UNKNOWN)
+        sql << "NULL";
+      else
+        sql << row.entry.amountAfter;
+      sql << ", " << uint32(row.entry.operation) << ", " << row.entry.time
+          << ")";
+    }
+    trans->Append(sql.str());
+  }
+  m_pending.clear();
+  if (wait)
+  {
+    ReagentBankDatabase.DirectCommitTransaction(trans);
+    return;
+  }
+  uint32 queued = getMSTime();
+  m_commitCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncCommitTransaction(trans).AfterComplete(
+          [queued](bool /*success*/)
+          { sReagentBankDatabasePool->RecordWait(queued); }));
+}
@@ -0,0 +1,107 @@
+#ifndef AZEROTHCORE_REAGENTBANKAUDIT_H
+#define AZEROTHCORE_REAGENTBANKAUDIT_H
+#include "AsyncCallbackProcessor.h"
+#include "DatabaseEnv.h"
+#include "Player.h"
+#include "ReagentBankLedger.h"
+#include <ctime>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define DEFAULT_AUDIT_FLUSH_INTERVAL 1000
+#define DEFAULT_AUDIT_HISTORY_SIZE 20
+#define AUDIT_ROWS_PER_INSERT 500
+// Resulting amount not known, e.g. a relative deposit to an unloaded bank
+#define AUDIT_AMOUNT_UNKNOWN -1
+
+enum ReagentBankAuditOperation : uint8 {
+  AUDIT_DEPOSIT = 0,
+  AUDIT_WITHDRAW = 1,
+  // Withdrawn items that did not fit into the bags after all
+  AUDIT_REFUND = 2,
+  // Deposit replayed from the journal after a crash
+  AUDIT_REPLAY = 3,
+  AUDIT_GUILD_DEPOSIT = 4,
+  AUDIT_GUILD_WITHDRAW = 5
+};
+
+struct ReagentBankAuditEntry
+{
+  time_t time;
+  // Character that made the change, 0 for the server itself
+  uint32 character;
+  uint32 entry;
+  int32 delta;
+  int64 amountAfter;
+  ReagentBankAuditOperation operation;
+};
+
+char const *GetReagentBankAuditOperationName(ReagentBankAuditOperation operation);
+
+// Trail of every change to a bank. The latest entries of each bank are kept
+// in a ring buffer for the banker's history page, and all of them are
+// written to mod_reagent_bank_account_log in batches every FlushInterval
+// ms, so recording costs no DB round trip of its own. A busy bank DB queue
+// postpones the batch.
+// Only used from the world thread.
+class ReagentBankAudit
+{
+public:
+  static ReagentBankAudit *instance();
+
+  void LoadConfig();
+  bool IsEnabled() const { return m_enabled; }
+
+  void Record(ReagentBankOwner const &owner, uint32 character, uint32 entry,
+              int32 delta, int64 amountAfter,
+              ReagentBankAuditOperation operation);
+  // Records every amount, taking the resulting amounts from the ledger when
+  // the bank is loaded. Withdraw operations are recorded as negative.
+  void Record(ReagentBankOwner const &owner, uint32 character,
+              std::vector<ReagentBankItemAmount> const &amounts,
+              ReagentBankAuditOperation operation);
+
+  // Invokes the callback with the latest entries of the bank, newest first;
+  // read from the log table unless they are in memory already
+  void LoadHistoryAsync(
+      Player *player, ReagentBankOwner const &owner,
+      std::function<void(std::vector<ReagentBankAuditEntry> const &)>
+          callback);
+
+  // Drops the bank's ring buffer and writes what is pending
+  void Unload(ReagentBankOwner const &owner);
+  void Update(uint32 diff);
+  void Flush(bool wait = false);
+
+private:
+  struct History
+  {
+    std::vector<ReagentBankAuditEntry> entries;
+    // Slot the next entry goes to once the buffer is full
+    size_t next = 0;
+
+    void Push(ReagentBankAuditEntry const &entry, size_t capacity);
+    std::vector<ReagentBankAuditEntry> GetNewestFirst() const;
+  };
+
+  struct PendingRow
+  {
+    ReagentBankOwner owner;
+    ReagentBankAuditEntry entry;
+  };
+
+  bool m_enabled = false;
+  uint32 m_flushInterval = DEFAULT_AUDIT_FLUSH_INTERVAL;
+  uint32 m_historySize = DEFAULT_AUDIT_HISTORY_SIZE;
+  uint32 m_timer = 0;
+
+  std::unordered_map<uint64, History> m_histories;
+  std::vector<PendingRow> m_pending;
+  AsyncCallbackProcessor<TransactionCallback> m_commitCallbacks;
+};
+
+#define sReagentBankAudit ReagentBankAudit::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKAUDIT_H
@@ -0,0 +1,256 @@
+#include "ReagentBankBenchmark.h"
+#include "Chat.h"
+#include "Log.h"
+#include "ObjectAccessor.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankPacked.h"
+#include "StringFormat.h"
+#include "Timer.h"
+#include "Util.h"
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace
+{
+char const *const BENCHMARK_OPERATION_NAMES[MAX_BENCHMARK_OPERATIONS] = {
+    "rows load", "rows save", "packed load", "packed save"};
+
+// Same definitions and indexes as the tables the ledger uses
+ReagentBankTables const BENCHMARK_TABLES = {
+    "mod_reagent_bank_account_bench_rows",
+    "mod_reagent_bank_account_bench_packed",
+    "mod_reagent_bank_account_bench_version",
+    "mod_reagent_bank_account_bench_ops"};
+
+uint64 ElapsedUs(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+void DropTables()
+{
+  ReagentBankAnalyticsDatabase.DirectExecute("DROP TABLE IF EXISTS {}, {}, {}, {}",
+                                             BENCHMARK_TABLES.rows,
+                                             BENCHMARK_TABLES.packed,
+                                             BENCHMARK_TABLES.version,
+                                             BENCHMARK_TABLES.ops);
+}
+} // namespace
+
+ReagentBankBenchmark *ReagentBankBenchmark::instance()
+{
+  static ReagentBankBenchmark instance;
+  return &instance;
+}
+
+void ReagentBankBenchmark::Timing::Add(uint64 us)
+{
+  ++count;
+  totalUs += us;
+  maxUs = std::max(maxUs, us);
+}
+
+bool ReagentBankBenchmark::Start(ObjectGuid requester, uint32 owners)
+{
+  // Sharing the bank's connections would hold up the banker
+  if (m_running || !sReagentBankDatabasePool->HasAnalyticsConnection())
+    return false;
+  // The previous run has finished, m_running was cleared
+  if (m_thread.joinable())
+    m_thread.join();
+
+  m_running = true;
+  m_stop = false;
+  m_requester = requester;
+  m_filled = 0;
+  m_target = 0;
+  std::vector<uint32> sizes;
+  if (owners)
+    sizes = {owners};
+  else
+    sizes = {10000, 100000, 1000000};
+  LOG_INFO("module", "Reagent bank benchmark: started, up to {} banks",
+           sizes.back());
+  m_thread = std::thread([this, sizes]() { Run(sizes); });
+  return true;
+}
+
+void ReagentBankBenchmark::Update()
+{
+  std::vector<std::string> reports;
+  {
+    std::lock_guard<std::mutex> guard(m_lock);
+    reports.swap(m_reports);
+  }
+  if (reports.empty())
+    return;
+  Player *player = ObjectAccessor::FindConnectedPlayer(m_requester);
+  if (!player)
+    return;
+  ChatHandler chat(player->GetSession());
+  for (std::string const &text : reports)
+    chat.SendSysMessage("Reagent bank benchmark: " + text);
+}
+
+void ReagentBankBenchmark::Shutdown()
+{
+  m_stop = true;
+  if (m_thread.joinable())
+    m_thread.join();
+}
+
+ReagentBankItemMap ReagentBankBenchmark::MakeBank(uint32 owner)
+{
+  std::mt19937 random(owner);
+  ReagentBankItemMap items;
+  for (uint32 i = 0; i < BENCHMARK_ENTRIES_PER_OWNER; ++i)
+    items[2000 + random() % 50000] = {uint32(random() % 8),
+                                      uint32(1 + random() % 1000)};
+  return items;
+}
+
+void ReagentBankBenchmark::Run(std::vector<uint32> sizes)
+{
+  m_random.seed(0);
+  m_token = 0;
+  m_timings = {};
+  DropTables();
+  ReagentBankAnalyticsDatabase.DirectExecute("CREATE TABLE {} LIKE mod_reagent_bank_account",
+                                             BENCHMARK_TABLES.rows);
+  ReagentBankAnalyticsDatabase.DirectExecute("CREATE TABLE {} LIKE mod_reagent_bank_account_packed",
+                                             BENCHMARK_TABLES.packed);
+  ReagentBankAnalyticsDatabase.DirectExecute("CREATE TABLE {} LIKE mod_reagent_bank_account_version",
+                                             BENCHMARK_TABLES.version);
+  ReagentBankAnalyticsDatabase.DirectExecute("CREATE TABLE {} LIKE mod_reagent_bank_account_ops",
+                                             BENCHMARK_TABLES.ops);
+
+  for (uint32 size : sizes)
+  {
+    m_target = size;
+    uint32 fillStart = getMSTime();
+    while (m_filled < size && !m_stop)
+      Fill(size);
+    for (uint32 i = 0; i < BENCHMARK_SAMPLES && !m_stop; ++i)
+      Measure();
+    if (m_stop)
+      break;
+    ReportSize(fillStart);
+    m_timings = {};
+  }
+
+  DropTables();
+  Report(m_stop ? "stopped" : "done");
+  m_running = false;
+}
+
+void ReagentBankBenchmark::Fill(uint32 target)
+{
+  uint32 first = m_filled + 1;
+  uint32 last = std::min(m_filled + BENCHMARK_INSERT_OWNERS, target);
+  std::ostringstream rows, packed, versions;
+  for (uint32 owner = first; owner <= last; ++owner)
+  {
+    bool firstRow = owner == first;
+    ReagentBankItemMap items = MakeBank(owner);
+    for (auto const &itr : items)
+    {
+      rows << (firstRow ? "(" : ", (") << owner << ", 0, " << itr.first
+           << ", " << itr.second.subclass << ", " << itr.second.amount << ")";
+      firstRow = false;
+    }
+    packed << (owner == first ? "(" : ", (") << owner << ", 0, X'"
+           << ByteArrayToHexStr(EncodeReagentBank(items)) << "')";
+    versions << (owner == first ? "(" : ", (") << owner << ", 0, 0)";
+  }
+  ReagentBankAnalyticsDatabase.DirectExecute("INSERT INTO {} (account_id, guid, item_entry, item_subclass, amount) VALUES {}",
+                                             BENCHMARK_TABLES.rows, rows.str());
+  ReagentBankAnalyticsDatabase.DirectExecute("INSERT INTO {} (account_id, guid, data) VALUES {}",
+                                             BENCHMARK_TABLES.packed,
+                                             packed.str());
+  ReagentBankAnalyticsDatabase.DirectExecute("INSERT INTO {} (account_id, guid, version) VALUES {}",
+                                             BENCHMARK_TABLES.version,
+                                             versions.str());
+  m_filled = last;
+  std::this_thread::sleep_for(
+      std::chrono::milliseconds(BENCHMARK_INSERT_PAUSE_MS));
+}
+
+void ReagentBankBenchmark::Measure()
+{
+  ReagentBankOwner owner;
+  owner.accountId = 1 + m_random() % m_filled;
+
+  // What the ledger does to read a bank, and to withdraw one reagent from it
+  for (ReagentBankStorageFormat storage :
+       {REAGENT_BANK_STORAGE_ROWS, REAGENT_BANK_STORAGE_PACKED})
+  {
+    uint8 load = storage == REAGENT_BANK_STORAGE_PACKED ? BENCHMARK_PACKED_LOAD
+                                                        : BENCHMARK_ROWS_LOAD;
+    auto start = std::chrono::steady_clock::now();
+    ReagentBankItemMap items;
+    uint32 version = ReagentBankLedger::ReadBank(
+        storage, ReagentBankAnalyticsDatabase.Query(ReagentBankLedger::GetLoadQuery(
+                     BENCHMARK_TABLES, storage, owner)),
+        items);
+    m_timings[load].Add(ElapsedUs(start));
+    if (items.empty() || version == UNREADABLE_VERSION)
+      continue;
+
+    auto changed = items.begin();
+    std::vector<ReagentBankItemAmount> amounts = {
+        {changed->first, changed->second.subclass,
+         changed->second.amount > 1 ? changed->second.amount - 1 : 1}};
+    uint64 token = ++m_token;
+    start = std::chrono::steady_clock::now();
+    auto trans = ReagentBankAnalyticsDatabase.BeginTransaction();
+    ReagentBankLedger::AppendVersionedWrite(trans, BENCHMARK_TABLES, storage,
+                                            owner, version, items, amounts,
+                                            token);
+    ReagentBankAnalyticsDatabase.DirectCommitTransaction(trans);
+    ReagentBankAnalyticsDatabase.Query("SELECT 1 FROM {} WHERE token = {}",
+                                       BENCHMARK_TABLES.ops, token);
+    m_timings[load + 1].Add(ElapsedUs(start));
+  }
+}
+
+void ReagentBankBenchmark::ReportSize(uint32 fillStart)
+{
+  uint64 rowsBytes = 0, packedBytes = 0;
+  ReagentBankAnalyticsDatabase.Query("ANALYZE TABLE {}, {}", BENCHMARK_TABLES.rows,
+                                     BENCHMARK_TABLES.packed);
+  if (QueryResult result = ReagentBankAnalyticsDatabase.Query(
+          "SELECT table_name, data_length + index_length FROM information_schema.tables WHERE table_schema = DATABASE() AND table_name IN ('{}', '{}')",
+          BENCHMARK_TABLES.rows, BENCHMARK_TABLES.packed))
+  {
+    do
+    {
+      Field *fields = result->Fetch();
+      if (fields[0].Get<std::string>() == BENCHMARK_TABLES.rows)
+        rowsBytes = fields[1].Get<uint64>();
+      else
+        packedBytes = fields[1].Get<uint64>();
+    } while (result->NextRow());
+  }
+  Report(Acore::StringFormat("{} banks of {} reagents, filled in {} s; rows tables {} MB, packed tables {} MB",
+                             uint32(m_filled), BENCHMARK_ENTRIES_PER_OWNER,
+                             getMSTimeDiff(fillStart, getMSTime()) / IN_MILLISECONDS,
+                             rowsBytes >> 20, packedBytes >> 20));
+  for (uint8 i = 0; i < MAX_BENCHMARK_OPERATIONS; ++i)
+  {
+    Timing const &timing = m_timings[i];
+    if (timing.count)
+      Report(Acore::StringFormat("  {}: {} us average, {} us max",
+                                 BENCHMARK_OPERATION_NAMES[i],
+                                 timing.totalUs / timing.count, timing.maxUs));
+  }
+}
+
+void ReagentBankBenchmark::Report(std::string const &text)
+{
+  LOG_INFO("module", "Reagent bank benchmark: {}", text);
+  std::lock_guard<std::mutex> guard(m_lock);
+  m_reports.push_back(text);
+}
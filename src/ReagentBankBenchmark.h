@@ -0,0 +1,97 @@
+#ifndef AZEROTHCORE_REAGENTBANKBENCHMARK_H
+#define AZEROTHCORE_REAGENTBANKBENCHMARK_H
+#include "ObjectGuid.h"
+#include "ReagentBankLedger.h"
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reagents of every synthetic bank, like a crafter's
+#define BENCHMARK_ENTRIES_PER_OWNER 40
+// Banks written by one INSERT while filling the tables
+#define BENCHMARK_INSERT_OWNERS 100
+// Between two INSERTs, so filling never saturates the DB
+#define BENCHMARK_INSERT_PAUSE_MS 10
+// Banks loaded and saved at every size
+#define BENCHMARK_SAMPLES 1000
+#define MAX_BENCHMARK_OWNERS 1000000
+
+enum ReagentBankBenchmarkOperation : uint8 {
+  BENCHMARK_ROWS_LOAD = 0,
+  BENCHMARK_ROWS_SAVE = 1,
+  BENCHMARK_PACKED_LOAD = 2,
+  BENCHMARK_PACKED_SAVE = 3,
+  MAX_BENCHMARK_OPERATIONS
+};
+
+// Compares the two storage formats on copies of the bank tables in the
+// characters DB, so no bank of a player is touched: both are filled with
+// the same synthetic banks, then random banks are read and written back
+// with one reagent changed, through the ledger's own load query and
+// versioned write (version bump, operation token and its read back). The
+// timings and table sizes are reported at every size. Without a size it
+// runs at 10k, 100k and 1M banks, growing the same tables.
+// Runs on a thread of its own over the analytics connection, so neither
+// the world thread nor the bank's connections wait for it; it still loads
+// the DB server, so run it off-peak. The tables are dropped when it is done
+// or the worldserver stops.
+class ReagentBankBenchmark
+{
+public:
+  static ReagentBankBenchmark *instance();
+
+  bool IsRunning() const { return m_running; }
+  uint32 GetFilled() const { return m_filled; }
+  uint32 GetTarget() const { return m_target; }
+
+  // False while running, or without the analytics connection. The result
+  // goes to the requester, if still online, and the log.
+  bool Start(ObjectGuid requester, uint32 owners);
+  // Sends what the run reported meanwhile to the requester
+  void Update();
+  // Stops a run and waits for its thread
+  void Shutdown();
+
+private:
+  struct Timing
+  {
+    uint64 count = 0;
+    uint64 totalUs = 0;
+    uint64 maxUs = 0;
+
+    void Add(uint64 us);
+  };
+
+  // Same banks on every run
+  static ReagentBankItemMap MakeBank(uint32 owner);
+  // On the benchmark's thread
+  void Run(std::vector<uint32> sizes);
+  void Fill(uint32 target);
+  void Measure();
+  void ReportSize(uint32 fillStart);
+  void Report(std::string const &text);
+
+  std::atomic<bool> m_running{false};
+  std::atomic<bool> m_stop{false};
+  std::thread m_thread;
+  ObjectGuid m_requester;
+  std::atomic<uint32> m_filled{0};
+  std::atomic<uint32> m_target{0};
+
+  // Only used by the benchmark's thread
+  std::mt19937 m_random;
+  uint64 m_token = 0;
+  std::array<Timing, MAX_BENCHMARK_OPERATIONS> m_timings;
+
+  // Reported but not sent yet
+  std::mutex m_lock;
+  std::vector<std::string> m_reports;
+};
+
+#define sReagentBankBenchmark ReagentBankBenchmark::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKBENCHMARK_H
@@ -0,0 +1,97 @@
+#include "ReagentBankCategory.h"
+#include "DatabaseEnv.h"
+#include "Log.h"
+#include <algorithm>
+
+ReagentBankCategories *ReagentBankCategories::instance()
+{
+  static ReagentBankCategories instance;
+  return &instance;
+}
+
+bool ReagentBankCategories::AddCategory(ReagentBankCategory const &category)
+{
+  if (category.id == NO_REAGENT_BANK_CATEGORY ||
+      category.id >= UNCATEGORIZED_REAGENT_BANK_CATEGORY ||
+      m_index[category.id])
+  {
+    LOG_ERROR("module", "Reagent bank: category id {} is invalid or used twice, skipped",
+              category.id);
+    return false;
+  }
+  m_categories.push_back(category);
+  m_index[category.id] = m_categories.size();
+  return true;
+}
+
+void ReagentBankCategories::AddItemClass(
+    ReagentBankCategoryItemClass const &itemClass)
+{
+  if (itemClass.itemClass >= MAX_ITEM_CLASS ||
+      itemClass.itemSubclass >= MAX_REAGENT_BANK_ITEM_SUBCLASSES ||
+      !IsCategory(itemClass.category))
+  {
+    LOG_ERROR("module", "Reagent bank: item class {}/{} mapped to unknown category {}, skipped",
+              itemClass.itemClass, itemClass.itemSubclass, itemClass.category);
+    return;
+  }
+  m_itemClasses[itemClass.itemClass][itemClass.itemSubclass] =
+      itemClass.category;
+}
+
+void ReagentBankCategories::Load()
+{
+  m_categories.clear();
+  m_index.fill(0);
+  for (auto &subclasses : m_itemClasses)
+    subclasses.fill(NO_REAGENT_BANK_CATEGORY);
+
+  if (QueryResult result = WorldDatabase.Query(
+          "SELECT id, name, icon_item, sort_order FROM mod_reagent_bank_account_category"))
+  {
+    do
+    {
+      Field *fields = result->Fetch();
+      AddCategory({fields[0].Get<uint32>(), fields[1].Get<std::string>(),
+                   fields[2].Get<uint32>(), fields[3].Get<uint32>()});
+    } while (result->NextRow());
+  }
+  else
+  {
+    uint32 sortOrder = 0;
+    for (ReagentBankCategoryDefault const &category :
+         DEFAULT_REAGENT_BANK_CATEGORIES)
+      AddCategory({category.id, category.name, category.iconItem, sortOrder++});
+  }
+
+  // Menu order; positions changed, so the index is built again
+  std::stable_sort(m_categories.begin(), m_categories.end(),
+                   [](ReagentBankCategory const &a, ReagentBankCategory const &b)
+                   { return a.sortOrder < b.sortOrder; });
+  m_index.fill(0);
+  for (size_t i = 0; i < m_categories.size(); ++i)
+    m_index[m_categories[i].id] = i + 1;
+  m_categories.push_back({UNCATEGORIZED_REAGENT_BANK_CATEGORY, "Uncategorized",
+                          UNCATEGORIZED_ICON_ITEM, 0});
+  m_index[UNCATEGORIZED_REAGENT_BANK_CATEGORY] = m_categories.size();
+
+  if (QueryResult result = WorldDatabase.Query(
+          "SELECT item_class, item_subclass, category FROM mod_reagent_bank_account_category_item_class"))
+  {
+    do
+    {
+      Field *fields = result->Fetch();
+      AddItemClass({fields[0].Get<uint32>(), fields[1].Get<uint32>(),
+                    fields[2].Get<uint32>()});
+    } while (result->NextRow());
+  }
+  else
+  {
+    for (ReagentBankCategoryItemClass const &itemClass :
+         DEFAULT_REAGENT_BANK_ITEM_CLASSES)
+      AddItemClass(itemClass);
+  }
+
+  LOG_INFO("module", ">> Loaded {} reagent bank categories",
+           m_categories.size());
+}
@@ -0,0 +1,133 @@
+#ifndef AZEROTHCORE_REAGENTBANKCATEGORY_H
+#define AZEROTHCORE_REAGENTBANKCATEGORY_H
+#include "ItemTemplate.h"
+#include <array>
+#include <string>
+#include <vector>
+
+// Category ids are gossip senders as well, the menu actions start above
+#define MAX_REAGENT_BANK_CATEGORIES 64
+#define MAX_REAGENT_BANK_ITEM_SUBCLASSES 32
+#define NO_REAGENT_BANK_CATEGORY 0
+// Built-in, last in the menu: stored reagents whose item class is no longer
+// in any category, so they can still be withdrawn
+#define UNCATEGORIZED_REAGENT_BANK_CATEGORY (MAX_REAGENT_BANK_CATEGORIES - 1)
+#define UNCATEGORIZED_ICON_ITEM 2604
+
+struct ReagentBankCategory
+{
+  uint32 id;
+  std::string name;
+  // Item whose icon is shown in the main menu
+  uint32 iconItem;
+  uint32 sortOrder;
+};
+
+struct ReagentBankCategoryDefault
+{
+  uint32 id;
+  char const *name;
+  uint32 iconItem;
+};
+
+struct ReagentBankCategoryItemClass
+{
+  uint32 itemClass;
+  uint32 itemSubclass;
+  uint32 category;
+};
+
+// Built-in categories, in menu order. The ids are the trade goods
+// subclasses, which is also what older versions stored.
+constexpr ReagentBankCategoryDefault DEFAULT_REAGENT_BANK_CATEGORIES[] = {
+    {ITEM_SUBCLASS_CLOTH, "Cloth", 2589},
+    {ITEM_SUBCLASS_MEAT, "Meat", 12208},
+    {ITEM_SUBCLASS_METAL_STONE, "Metal & Stone", 2772},
+    {ITEM_SUBCLASS_ENCHANTING, "Enchanting", 10940},
+    {ITEM_SUBCLASS_ELEMENTAL, "Elemental", 7068},
+    {ITEM_SUBCLASS_PARTS, "Parts", 4359},
+    {ITEM_SUBCLASS_TRADE_GOODS_OTHER, "Other Trade Goods", 2604},
+    {ITEM_SUBCLASS_HERB, "Herb", 2453},
+    {ITEM_SUBCLASS_LEATHER, "Leather", 2318},
+    {ITEM_SUBCLASS_JEWELCRAFTING, "Jewelcrafting", 1206},
+    {ITEM_SUBCLASS_EXPLOSIVES, "Explosives", 4358},
+    {ITEM_SUBCLASS_DEVICES, "Devices", 4388},
+    {ITEM_SUBCLASS_MATERIAL, "Nether Material", 23572},
+    {ITEM_SUBCLASS_ARMOR_ENCHANTMENT, "Armor Vellum", 38682},
+    {ITEM_SUBCLASS_WEAPON_ENCHANTMENT, "Weapon Vellum", 39349}};
+
+// Every trade goods subclass goes to its own category, plain trade goods to
+// the other ones, and all gems to jewelcrafting
+constexpr ReagentBankCategoryItemClass DEFAULT_REAGENT_BANK_ITEM_CLASSES[] = {
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_TRADE_GOODS, ITEM_SUBCLASS_TRADE_GOODS_OTHER},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_PARTS, ITEM_SUBCLASS_PARTS},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_EXPLOSIVES, ITEM_SUBCLASS_EXPLOSIVES},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_DEVICES, ITEM_SUBCLASS_DEVICES},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_JEWELCRAFTING, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_CLOTH, ITEM_SUBCLASS_CLOTH},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_LEATHER, ITEM_SUBCLASS_LEATHER},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_METAL_STONE, ITEM_SUBCLASS_METAL_STONE},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_MEAT, ITEM_SUBCLASS_MEAT},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_HERB, ITEM_SUBCLASS_HERB},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_ELEMENTAL, ITEM_SUBCLASS_ELEMENTAL},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_TRADE_GOODS_OTHER, ITEM_SUBCLASS_TRADE_GOODS_OTHER},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_ENCHANTING, ITEM_SUBCLASS_ENCHANTING},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_MATERIAL, ITEM_SUBCLASS_MATERIAL},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_ARMOR_ENCHANTMENT, ITEM_SUBCLASS_ARMOR_ENCHANTMENT},
+    {ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_WEAPON_ENCHANTMENT, ITEM_SUBCLASS_WEAPON_ENCHANTMENT},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_RED, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_BLUE, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_YELLOW, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_PURPLE, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_GREEN, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_ORANGE, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_META, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_SIMPLE, ITEM_SUBCLASS_JEWELCRAFTING},
+    {ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_PRISMATIC, ITEM_SUBCLASS_JEWELCRAFTING}};
+
+// The reagent bank categories: the defaults above, or the contents of the
+// world tables mod_reagent_bank_account_category and
+// mod_reagent_bank_account_category_item_class when they have rows. Both
+// are compiled into arrays, so classifying an item and finding a category
+// are single lookups. Loaded once on startup and read-only afterwards.
+class ReagentBankCategories
+{
+public:
+  static ReagentBankCategories *instance();
+
+  void Load();
+
+  // NO_REAGENT_BANK_CATEGORY for items the bank does not take
+  uint32 GetCategory(ItemTemplate const *itemTemplate) const
+  {
+    if (itemTemplate->Class >= MAX_ITEM_CLASS ||
+        itemTemplate->SubClass >= MAX_REAGENT_BANK_ITEM_SUBCLASSES)
+      return NO_REAGENT_BANK_CATEGORY;
+    return m_itemClasses[itemTemplate->Class][itemTemplate->SubClass];
+  }
+  // nullptr for unknown ids
+  ReagentBankCategory const *GetById(uint32 id) const
+  {
+    if (id >= MAX_REAGENT_BANK_CATEGORIES || !m_index[id])
+      return nullptr;
+    return &m_categories[m_index[id] - 1];
+  }
+  bool IsCategory(uint32 id) const { return GetById(id) != nullptr; }
+  // In menu order
+  std::vector<ReagentBankCategory> const &GetAll() const { return m_categories; }
+
+private:
+  bool AddCategory(ReagentBankCategory const &category);
+  void AddItemClass(ReagentBankCategoryItemClass const &itemClass);
+
+  std::vector<ReagentBankCategory> m_categories;
+  // id -> position in m_categories + 1, 0 for none
+  std::array<uint8, MAX_REAGENT_BANK_CATEGORIES> m_index{};
+  std::array<std::array<uint8, MAX_REAGENT_BANK_ITEM_SUBCLASSES>,
+             MAX_ITEM_CLASS>
+      m_itemClasses{};
+};
+
+#define sReagentBankCategories ReagentBankCategories::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKCATEGORY_H
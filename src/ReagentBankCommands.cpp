@@ -0,0 +1,242 @@
+#include "ReagentBankAccount.h"
+#include "AccountMgr.h"
+#include "CharacterCache.h"
+#include "GameTime.h"
+#include "GuildMgr.h"
+#include "ReagentBankAnalytics.h"
+#include "ReagentBankBenchmark.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankLedger.h"
+#include "ReagentBankSearch.h"
+#include "ReagentBankThrottle.h"
+
+using namespace Acore::ChatCommands;
+
+// .reagentbank commands
+class mod_reagent_bank_account_commands : public CommandScript
+{
+public:
+  mod_reagent_bank_account_commands()
+      : CommandScript("mod_reagent_bank_account_commands")
+  {
+  }
+
+  ChatCommandTable GetCommands() const override
+  {
+    static ChatCommandTable analyticsCommandTable = {
+        {"total", HandleReagentBankAnalyticsTotalCommand, SEC_GAMEMASTER, Console::Yes},
+        {"top", HandleReagentBankAnalyticsTopCommand, SEC_GAMEMASTER, Console::Yes},
+        {"categories", HandleReagentBankAnalyticsCategoriesCommand, SEC_GAMEMASTER, Console::Yes},
+        {"refresh", HandleReagentBankAnalyticsRefreshCommand, SEC_GAMEMASTER, Console::Yes}};
+    static ChatCommandTable reagentBankCommandTable = {
+        {"search", HandleReagentBankSearchCommand, SEC_PLAYER, Console::No},
+        {"stats", HandleReagentBankStatsCommand, SEC_GAMEMASTER, Console::Yes},
+        {"benchmark", HandleReagentBankBenchmarkCommand, SEC_ADMINISTRATOR, Console::Yes},
+        {"analytics", analyticsCommandTable}};
+    static ChatCommandTable commandTable = {
+        {"reagentbank", reagentBankCommandTable}};
+    return commandTable;
+  }
+
+  // Lists the stored reagents whose name contains the given text
+  static bool HandleReagentBankSearchCommand(ChatHandler *handler, Tail text)
+  {
+    if (text.empty())
+    {
+      handler->SendSysMessage("Usage: .reagentbank search <name>");
+      handler->SetSentErrorMessage(true);
+      return false;
+    }
+    Player *player = handler->GetSession()->GetPlayer();
+    if (!sReagentBankThrottle->Allow(player->GetGUID().GetCounter()))
+    {
+      handler->SendSysMessage("The reagent bank is busy, please slow down.");
+      handler->SetSentErrorMessage(true);
+      return false;
+    }
+    std::string searchText(text);
+    sReagentBankLedger->LoadAsync(
+        player, [player, searchText](ReagentBankItemMap const &items)
+        {
+          ChatHandler chat(player->GetSession());
+          std::vector<std::pair<uint32, uint32>> found =
+              sReagentBankSearchIndex->FindStored(items, searchText,
+                                                  MAX_SEARCH_RESULTS);
+          if (found.empty())
+          {
+            chat.PSendSysMessage("No stored reagents match \"{}\".", searchText);
+            return;
+          }
+          chat.PSendSysMessage("Stored reagents matching \"{}\":", searchText);
+          for (std::pair<uint32, uint32> const &match : found)
+            chat.PSendSysMessage("{} x {}",
+                                 GetReagentBankItemLink(match.first,
+                                                        player->GetSession()),
+                                 match.second);
+        });
+    return true;
+  }
+
+  // Shows how often the per-player limits kicked in and how loaded the
+  // bank's DB queue is
+  static bool HandleReagentBankStatsCommand(ChatHandler *handler)
+  {
+    handler->PSendSysMessage("Reagent bank throttled actions: {}",
+                             sReagentBankThrottle->GetThrottledCount());
+    handler->PSendSysMessage("Reagent bank coalesced deposits: {}",
+                             sReagentBankThrottle->GetCoalescedCount());
+    handler->PSendSysMessage("Reagent bank superseded renders: {}",
+                             sReagentBankThrottle->GetSupersededCount());
+    ReagentBankDatabasePool *pool = sReagentBankDatabasePool;
+    handler->PSendSysMessage("Reagent bank DB queue ({} connections): {} of {}, peak {}",
+                             pool->IsSeparate() ? "own" : "core",
+                             pool->GetQueueDepth(), pool->GetMaxQueueDepth(),
+                             pool->GetPeakQueueDepth());
+    handler->PSendSysMessage("Reagent bank DB waits: {} ms average, {} ms max over {} operations",
+                             pool->GetAverageWait(), pool->GetMaxWait(),
+                             pool->GetCompletedCount());
+    handler->PSendSysMessage("Reagent bank DB refused or postponed: {}",
+                             pool->GetRejectedCount());
+    return true;
+  }
+
+  // Returns the latest snapshot, starting a new one when it is missing or
+  // too old. nullptr when there is nothing to show yet.
+  static std::shared_ptr<ReagentBankSnapshot const>
+  GetSnapshot(ChatHandler *handler)
+  {
+    std::shared_ptr<ReagentBankSnapshot const> snapshot =
+        sReagentBankAnalytics->GetSnapshot();
+    if (!snapshot || sReagentBankAnalytics->IsStale(*snapshot))
+      sReagentBankAnalytics->Refresh();
+    if (!snapshot)
+    {
+      handler->SendSysMessage("The reagent bank snapshot is being computed, try again shortly.");
+      handler->SetSentErrorMessage(true);
+      return nullptr;
+    }
+    handler->PSendSysMessage("Reagent bank snapshot of {} banks, {} seconds old{}.",
+                             snapshot->banks,
+                             GameTime::GetGameTime().count() - snapshot->time,
+                             sReagentBankAnalytics->IsRunning() ? ", a new one is being computed" : "");
+    return snapshot;
+  }
+
+  // Item link in game, plain name on the console
+  static std::string GetItemName(ChatHandler *handler, uint32 entry)
+  {
+    if (handler->GetSession())
+      return GetReagentBankItemLink(entry, handler->GetSession());
+    ItemTemplate const *temp = sObjectMgr->GetItemTemplate(entry);
+    return temp ? temp->Name1 : "item " + std::to_string(entry);
+  }
+
+  static std::string GetOwnerName(ReagentBankOwner const &owner)
+  {
+    std::string name;
+    if (owner.guildId)
+    {
+      if (Guild *guild = sGuildMgr->GetGuildById(owner.guildId))
+        return "guild " + guild->GetName();
+      return "guild " + std::to_string(owner.guildId);
+    }
+    if (owner.accountId)
+    {
+      if (AccountMgr::GetName(owner.accountId, name))
+        return "account " + name;
+      return "account " + std::to_string(owner.accountId);
+    }
+    if (sCharacterCache->GetCharacterNameByGuid(
+            ObjectGuid::Create<HighGuid::Player>(owner.guid), name))
+      return name;
+    return "character " + std::to_string(owner.guid);
+  }
+
+  // Compares the rows and the packed storage format on synthetic banks, at
+  // the given number of banks or at 10k, 100k and 1M
+  static bool HandleReagentBankBenchmarkCommand(ChatHandler *handler,
+                                                Optional<uint32> owners)
+  {
+    if (sReagentBankBenchmark->IsRunning())
+    {
+      handler->PSendSysMessage("A reagent bank benchmark is running, {} of {} banks written.",
+                               sReagentBankBenchmark->GetFilled(),
+                               sReagentBankBenchmark->GetTarget());
+      return true;
+    }
+    uint32 count =
+        owners ? std::min<uint32>(*owners, MAX_BENCHMARK_OWNERS) : 0;
+    Player *player =
+        handler->GetSession() ? handler->GetSession()->GetPlayer() : nullptr;
+    if (!sReagentBankBenchmark->Start(
+            player ? player->GetGUID() : ObjectGuid::Empty, count))
+    {
+      handler->SendSysMessage("The reagent bank benchmark needs the analytics characters DB connection, which could not be opened.");
+      handler->SetSentErrorMessage(true);
+      return false;
+    }
+    handler->SendSysMessage("Reagent bank benchmark started, the results follow as each size is done.");
+    return true;
+  }
+
+  // Total amount of an item held in all reagent banks
+  static bool HandleReagentBankAnalyticsTotalCommand(ChatHandler *handler,
+                                                     uint32 itemEntry)
+  {
+    std::shared_ptr<ReagentBankSnapshot const> snapshot = GetSnapshot(handler);
+    if (!snapshot)
+      return false;
+    auto total = snapshot->totals.find(itemEntry);
+    handler->PSendSysMessage("{}: {} stored",
+                             GetItemName(handler, itemEntry),
+                             total != snapshot->totals.end() ? total->second : 0);
+    return true;
+  }
+
+  // Banks holding the most of an item
+  static bool HandleReagentBankAnalyticsTopCommand(ChatHandler *handler,
+                                                   uint32 itemEntry)
+  {
+    std::shared_ptr<ReagentBankSnapshot const> snapshot = GetSnapshot(handler);
+    if (!snapshot)
+      return false;
+    auto holders = snapshot->topHolders.find(itemEntry);
+    if (holders == snapshot->topHolders.end())
+    {
+      handler->PSendSysMessage("{}: nobody stores any", GetItemName(handler, itemEntry));
+      return true;
+    }
+    handler->PSendSysMessage("{}: top holders", GetItemName(handler, itemEntry));
+    for (ReagentBankSnapshot::Holder const &holder : holders->second)
+      handler->PSendSysMessage("  {} x {}", GetOwnerName(holder.owner),
+                               holder.amount);
+    return true;
+  }
+
+  // Amount stored per category
+  static bool HandleReagentBankAnalyticsCategoriesCommand(ChatHandler *handler)
+  {
+    std::shared_ptr<ReagentBankSnapshot const> snapshot = GetSnapshot(handler);
+    if (!snapshot)
+      return false;
+    for (auto const &category : snapshot->categories)
+      handler->PSendSysMessage("  {}: {}",
+                               GetReagentBankCategoryName(category.first),
+                               category.second);
+    return true;
+  }
+
+  static bool HandleReagentBankAnalyticsRefreshCommand(ChatHandler *handler)
+  {
+    if (!sReagentBankAnalytics->Refresh())
+      handler->SendSysMessage("A reagent bank snapshot is already being computed.");
+    else
+      handler->SendSysMessage("Computing a new reagent bank snapshot.");
+    return true;
+  }
+};
+
+void AddSC_mod_reagent_bank_account_commands()
+{
+  new mod_reagent_bank_account_commands();
+}
@@ -0,0 +1,99 @@
+#include "ReagentBankDatabase.h"
+#include "Config.h"
+#include "Log.h"
+#include "Timer.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+ReagentBankDatabasePool *ReagentBankDatabasePool::instance()
+{
+  static ReagentBankDatabasePool instance;
+  return &instance;
+}
+
+void ReagentBankDatabasePool::LoadConfig()
+{
+  m_separate = sConfigMgr->GetOption<bool>(
+      "ReagentBankAccount.Database.Separate", true);
+  m_workerThreads = std::max<uint8>(
+      1, sConfigMgr->GetOption<uint8>("ReagentBankAccount.Database.WorkerThreads",
+                                      DEFAULT_DATABASE_WORKER_THREADS));
+  m_synchThreads = std::max<uint8>(
+      1, sConfigMgr->GetOption<uint8>("ReagentBankAccount.Database.SynchThreads",
+                                      DEFAULT_DATABASE_SYNCH_THREADS));
+  m_maxQueueDepth = std::max<uint32>(
+      1, sConfigMgr->GetOption<uint32>("ReagentBankAccount.Database.MaxQueueDepth",
+                                       DEFAULT_DATABASE_MAX_QUEUE_DEPTH));
+}
+
+void ReagentBankDatabasePool::Open()
+{
+  // Same DB as the core, other connections
+  std::string info =
+      sConfigMgr->GetOption<std::string>("CharacterDatabaseInfo", "");
+  if (!m_analyticsOpen)
+  {
+    // Only its synchronous connection is used
+    m_analyticsPool.SetConnectionInfo(info, 1, 1);
+    if (uint32 error = m_analyticsPool.Open())
+      LOG_ERROR("module", "Reagent bank: could not open the analytics characters DB connection (error {}), sharing the bank's",
+                error);
+    else
+      m_analyticsOpen = true;
+  }
+
+  if (!m_separate || m_open)
+    return;
+  m_pool.SetConnectionInfo(info, m_workerThreads, m_synchThreads);
+  // The module runs no prepared statements, so the core's are not prepared
+  if (uint32 error = m_pool.Open())
+  {
+    LOG_ERROR("module", "Reagent bank: could not open its own characters DB connections (error {}), using the core's",
+              error);
+    return;
+  }
+  m_open = true;
+  LOG_INFO("module", ">> Reagent bank uses {} async and {} sync characters DB connections of its own",
+           m_workerThreads, m_synchThreads);
+}
+
+void ReagentBankDatabasePool::Close()
+{
+  if (m_analyticsOpen)
+  {
+    m_analyticsOpen = false;
+    m_analyticsPool.Close();
+  }
+  if (!m_open)
+    return;
+  // Closing drops whatever is still queued; deposits among it would only
+  // come back through the journal replay on the next start
+  uint32 start = getMSTime();
+  while (m_pool.QueueSize() && getMSTimeDiff(start, getMSTime()) <
+                                   DATABASE_CLOSE_TIMEOUT_MS)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  m_open = false;
+  m_pool.Close();
+}
+
+bool ReagentBankDatabasePool::IsBusy()
+{
+  if (GetQueueDepth() < m_maxQueueDepth)
+    return false;
+  ++m_rejected;
+  return true;
+}
+
+void ReagentBankDatabasePool::RecordWait(uint32 queuedTime)
+{
+  uint32 wait = getMSTimeDiff(queuedTime, getMSTime());
+  ++m_completed;
+  m_totalWait += wait;
+  m_maxWait = std::max(m_maxWait, wait);
+}
+
+void ReagentBankDatabasePool::Update()
+{
+  m_peakQueueDepth = std::max(m_peakQueueDepth, GetQueueDepth());
+}
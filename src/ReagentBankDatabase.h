@@ -0,0 +1,93 @@
+#ifndef AZEROTHCORE_REAGENTBANKDATABASE_H
+#define AZEROTHCORE_REAGENTBANKDATABASE_H
+#include "DatabaseEnv.h"
+
+#define DEFAULT_DATABASE_WORKER_THREADS 1
+#define DEFAULT_DATABASE_SYNCH_THREADS 1
+#define DEFAULT_DATABASE_MAX_QUEUE_DEPTH 100
+// How long the shutdown waits for queued bank writes before closing the pool
+#define DATABASE_CLOSE_TIMEOUT_MS 10000
+
+// Connections of the reagent bank to the characters DB. By default the
+// module opens a pool of its own, so a burst of bank writes queues behind
+// other bank writes only and never ahead of the core's character saves.
+// Without it (or when it cannot be opened) the core's CharacterDatabase is
+// used.
+// Either way the queue is bounded: once MaxQueueDepth statements wait for a
+// worker, IsBusy() is true and new deposits are refused, guild merges and
+// audit writes are postponed. Falling back to the core's pool, the core's
+// own queue counts as well, so the bank yields to the core's writes.
+// The analytics scan and the benchmark get one more connection of their
+// own, so their reads and writes never hold up the bank's own synchronous
+// queries waiting for the same connection.
+// Get() and GetAnalytics() may be used from any thread, everything else only
+// from the world thread.
+class ReagentBankDatabasePool
+{
+public:
+  static ReagentBankDatabasePool *instance();
+
+  void LoadConfig();
+  // Opens the module's own pool, if configured, and the analytics
+  // connection; before anything else runs
+  void Open();
+  // Waits a while for the queued writes, then closes the module's own
+  // connections. The analytics and benchmark threads must have stopped.
+  void Close();
+
+  DatabaseWorkerPool<CharacterDatabaseConnection> &Get()
+  {
+    return m_open ? m_pool : CharacterDatabase;
+  }
+  DatabaseWorkerPool<CharacterDatabaseConnection> &GetAnalytics()
+  {
+    return m_analyticsOpen ? m_analyticsPool : Get();
+  }
+  bool IsSeparate() const { return m_open; }
+  bool HasAnalyticsConnection() const { return m_analyticsOpen; }
+
+  // Statements waiting for an async worker
+  size_t GetQueueDepth() { return Get().QueueSize(); }
+  uint32 GetMaxQueueDepth() const { return m_maxQueueDepth; }
+  // Counts a refusal when busy
+  bool IsBusy();
+
+  // Records the time from queuing an operation until its result reached
+  // the world thread
+  void RecordWait(uint32 queuedTime);
+  // Samples the queue depth for the peak, from the world thread
+  void Update();
+
+  uint64 GetCompletedCount() const { return m_completed; }
+  uint32 GetAverageWait() const
+  {
+    return m_completed ? uint32(m_totalWait / m_completed) : 0;
+  }
+  uint32 GetMaxWait() const { return m_maxWait; }
+  size_t GetPeakQueueDepth() const { return m_peakQueueDepth; }
+  uint64 GetRejectedCount() const { return m_rejected; }
+
+private:
+  bool m_separate = true;
+  uint8 m_workerThreads = DEFAULT_DATABASE_WORKER_THREADS;
+  uint8 m_synchThreads = DEFAULT_DATABASE_SYNCH_THREADS;
+  uint32 m_maxQueueDepth = DEFAULT_DATABASE_MAX_QUEUE_DEPTH;
+
+  DatabaseWorkerPool<CharacterDatabaseConnection> m_pool;
+  bool m_open = false;
+  DatabaseWorkerPool<CharacterDatabaseConnection> m_analyticsPool;
+  bool m_analyticsOpen = false;
+
+  uint64 m_completed = 0;
+  uint64 m_totalWait = 0;
+  uint32 m_maxWait = 0;
+  size_t m_peakQueueDepth = 0;
+  uint64 m_rejected = 0;
+};
+
+#define sReagentBankDatabasePool ReagentBankDatabasePool::instance()
+// Used like the core's CharacterDatabase
+#define ReagentBankDatabase (sReagentBankDatabasePool->Get())
+#define ReagentBankAnalyticsDatabase (sReagentBankDatabasePool->GetAnalytics())
+
+#endif // AZEROTHCORE_REAGENTBANKDATABASE_H
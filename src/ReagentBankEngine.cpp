@@ -0,0 +1,369 @@
+#include "ReagentBankEngine.h"
+#include "Bag.h"
+#include "Chat.h"
+#include "ObjectAccessor.h"
+#include "ReagentBankAccount.h"
+#include "ReagentBankAudit.h"
+#include "StringFormat.h"
+#include <algorithm>
+#include <map>
+
+Player *ReagentBankPlayerBags::GetPlayer() const
+{
+  return ObjectAccessor::FindConnectedPlayer(m_playerGuid);
+}
+
+ReagentBankOwner ReagentBankPlayerBags::GetOwner() const
+{
+  return GetReagentBankOwner(GetPlayer());
+}
+
+uint32 ReagentBankPlayerBags::GetCharacter() const
+{
+  return m_playerGuid.GetCounter();
+}
+
+std::vector<ReagentBankItemAmount> ReagentBankPlayerBags::TakeReagents(
+    std::function<bool(ItemTemplate const *)> const &filter,
+    std::vector<uint32> &itemGuids)
+{
+  Player *player = GetPlayer();
+  std::map<uint32, uint32> entryToSubclassMap;
+  std::map<uint32, uint32> itemsAddedMap;
+
+  // Updates the item count maps and removes the item from the player's
+  // inventory
+  auto takeItem = [&](Item *pItem, uint8 bagSlot, uint8 itemSlot)
+  {
+    // Only allow trade goods and gems, and skip unique items
+    if (!IsReagentBankItem(pItem->GetTemplate()) || !filter(pItem->GetTemplate()))
+      return;
+    uint32 itemEntry = pItem->GetTemplate()->ItemId;
+    entryToSubclassMap[itemEntry] = GetReagentBankCategory(pItem->GetTemplate());
+    // Track what was deposited, this is also what gets added to the bank
+    itemsAddedMap[itemEntry] += pItem->GetCount();
+    // The journal replay checks whether the removal was saved
+    itemGuids.push_back(pItem->GetGUID().GetCounter());
+    player->DestroyItem(bagSlot, itemSlot, true);
+  };
+
+  // Inventory Items
+  for (uint8 i = INVENTORY_SLOT_ITEM_START; i < INVENTORY_SLOT_ITEM_END; ++i)
+  {
+    if (Item *pItem = player->GetItemByPos(INVENTORY_SLOT_BAG_0, i))
+      takeItem(pItem, INVENTORY_SLOT_BAG_0, i);
+  }
+  // Bag Items
+  for (uint8 i = INVENTORY_SLOT_BAG_START; i < INVENTORY_SLOT_BAG_END; i++)
+  {
+    Bag *bag = player->GetBagByPos(i);
+    if (!bag)
+      continue;
+    for (uint32 j = 0; j < bag->GetBagSize(); j++)
+    {
+      if (Item *pItem = player->GetItemByPos(i, j))
+        takeItem(pItem, i, j);
+    }
+  }
+
+  std::vector<ReagentBankItemAmount> deposits;
+  for (std::pair<uint32, uint32> mapEntry : itemsAddedMap)
+    deposits.push_back({mapEntry.first,
+                        entryToSubclassMap.find(mapEntry.first)->second,
+                        mapEntry.second});
+  return deposits;
+}
+
+ReagentBankBagPlanner ReagentBankPlayerBags::PlanSpace() const
+{
+  return ReagentBankBagPlanner(GetPlayer());
+}
+
+uint32 ReagentBankPlayerBags::Store(ItemTemplate const *itemTemplate,
+                                    uint32 count)
+{
+  // The core stays authoritative on where (and whether) items fit
+  Player *player = GetPlayer();
+  uint32 noSpaceForCount = 0;
+  ItemPosCountVec dest;
+  InventoryResult msg = player->CanStoreNewItem(
+      NULL_BAG, NULL_SLOT, dest, itemTemplate->ItemId, count, &noSpaceForCount);
+  if (msg != EQUIP_ERR_OK)
+    count = dest.empty() ? 0 : count - std::min(count, noSpaceForCount);
+  if (count == 0)
+    return 0;
+  Item *item = player->StoreNewItem(dest, itemTemplate->ItemId, true);
+  player->SendNewItem(item, count, true, false);
+  return count;
+}
+
+void ReagentBankPlayerBags::SendNoSpace(ItemTemplate const *itemTemplate,
+                                        uint32 count)
+{
+  GetPlayer()->SendEquipError(EQUIP_ERR_INVENTORY_FULL, nullptr, nullptr,
+                              itemTemplate->ItemId);
+  SendMessage(Acore::StringFormat("Not enough bag space to withdraw {} x {}.",
+                                  count, itemTemplate->Name1));
+}
+
+void ReagentBankPlayerBags::SendMessage(std::string const &text)
+{
+  ChatHandler(GetPlayer()->GetSession()).SendSysMessage(text);
+}
+
+ReagentBankEngine *ReagentBankEngine::instance()
+{
+  static ReagentBankEngine instance(*sReagentBankLedger);
+  return &instance;
+}
+
+std::vector<ReagentBankItemAmount>
+ReagentBankEngine::DepositAllReagents(ReagentBankBags &bags,
+                                      std::function<void()> callback)
+{
+  std::vector<uint32> itemGuids;
+  std::vector<ReagentBankItemAmount> deposits = bags.TakeReagents(
+      [](ItemTemplate const *) { return true; }, itemGuids);
+  // Write all changes to the DB in a transaction
+  if (!deposits.empty())
+  {
+    m_ledger.Deposit(bags.GetOwner(), deposits, itemGuids, callback);
+    sReagentBankAudit->Record(bags.GetOwner(), bags.GetCharacter(), deposits,
+                              AUDIT_DEPOSIT);
+  }
+  return deposits;
+}
+
+std::vector<ReagentBankItemAmount>
+ReagentBankEngine::DepositAllReagentsForCategory(ReagentBankBags &bags,
+                                                 uint32 category)
+{
+  std::vector<uint32> itemGuids;
+  std::vector<ReagentBankItemAmount> deposits = bags.TakeReagents(
+      [category](ItemTemplate const *itemTemplate)
+      { return GetReagentBankCategory(itemTemplate) == category; },
+      itemGuids);
+  if (!deposits.empty())
+  {
+    m_ledger.Deposit(bags.GetOwner(), deposits, itemGuids);
+    sReagentBankAudit->Record(bags.GetOwner(), bags.GetCharacter(), deposits,
+                              AUDIT_DEPOSIT);
+  }
+  return deposits;
+}
+
+void ReagentBankEngine::SendDepositFeedback(
+    ReagentBankBags &bags, std::vector<ReagentBankItemAmount> const &deposits,
+    char const *emptyMessage) const
+{
+  if (deposits.empty())
+  {
+    bags.SendMessage(emptyMessage);
+    return;
+  }
+  bags.SendMessage("The following was deposited:");
+  for (ReagentBankItemAmount const &deposit : deposits)
+  {
+    ItemTemplate const *itemTemplate =
+        sObjectMgr->GetItemTemplate(deposit.entry);
+    bags.SendMessage(std::to_string(deposit.amount) + " " +
+                     itemTemplate->Name1);
+  }
+}
+
+void ReagentBankEngine::WithdrawEntries(
+    std::shared_ptr<ReagentBankBags> bags,
+    std::function<bool(uint32, ReagentBankStoredItem const &)> select,
+    ReagentBankWithdrawLimit limit, ReagentBankWithdrawCallback done)
+{
+  WithdrawAttempt(bags, bags->GetOwner(), bags->GetCharacter(), select, limit,
+                  done, 0);
+}
+
+void ReagentBankEngine::WithdrawAttempt(
+    std::shared_ptr<ReagentBankBags> bags, ReagentBankOwner owner,
+    uint32 character,
+    std::function<bool(uint32, ReagentBankStoredItem const &)> select,
+    ReagentBankWithdrawLimit limit, ReagentBankWithdrawCallback done,
+    uint32 attempt)
+{
+  m_ledger.ReadAsync(owner, [=, this](ReagentBankItemMap const &items,
+                                      uint32 version)
+  {
+    // Logged out meanwhile, nothing was written yet
+    if (!bags->IsAvailable())
+      return;
+    ReagentBankBagPlanner planner = bags->PlanSpace();
+    std::vector<ReagentBankItemAmount> planned;
+    std::vector<ReagentBankItemAmount> remaining;
+    std::vector<ReagentBankItemAmount> noSpace;
+    bool found = false;
+    for (auto const &itr : items)
+    {
+      if (!select(itr.first, itr.second))
+        continue;
+      found = true;
+      ItemTemplate const *temp = sObjectMgr->GetItemTemplate(itr.first);
+      if (!temp)
+        continue;
+      uint32 wanted = itr.second.amount;
+      if (limit == WITHDRAW_LIMIT_ONE)
+        wanted = std::min<uint32>(wanted, 1);
+      else if (limit == WITHDRAW_LIMIT_STACK)
+        wanted = std::min(wanted, temp->GetMaxStackSize());
+      uint32 toGive = planner.Reserve(temp, wanted);
+      if (toGive < wanted)
+        noSpace.push_back({itr.first, itr.second.subclass, wanted - toGive});
+      if (toGive == 0)
+        continue;
+      planned.push_back({itr.first, itr.second.subclass, toGive});
+      remaining.push_back(
+          {itr.first, itr.second.subclass, itr.second.amount - toGive});
+    }
+
+    // Told once, after the attempt that counts
+    auto sendNoSpace = [bags, noSpace]()
+    {
+      for (ReagentBankItemAmount const &missing : noSpace)
+        bags->SendNoSpace(sObjectMgr->GetItemTemplate(missing.entry),
+                          missing.amount);
+    };
+    if (planned.empty())
+    {
+      sendNoSpace();
+      if (done)
+        done(false, found);
+      return;
+    }
+    m_ledger.CommitVersionedAsync(
+        owner, version, items, remaining, [=, this](bool committed)
+        {
+          if (!committed)
+          {
+            if (attempt + 1 < MAX_WRITE_ATTEMPTS)
+              WithdrawAttempt(bags, owner, character, select, limit, done,
+                              attempt + 1);
+            else if (bags->IsAvailable())
+            {
+              bags->SendMessage("The reagent bank is busy, please try again.");
+              if (done)
+                done(false, found);
+            }
+            return;
+          }
+          sReagentBankAudit->Record(owner, character, planned,
+                                    AUDIT_WITHDRAW);
+
+          // Whatever the bags refuse after all goes back into the bank, all
+          // of it when the player logged out meanwhile
+          bool available = bags->IsAvailable();
+          std::vector<ReagentBankItemAmount> refused;
+          if (!available)
+            refused = planned;
+          else
+          {
+            sendNoSpace();
+            for (ReagentBankItemAmount const &withdraw : planned)
+            {
+              ItemTemplate const *temp =
+                  sObjectMgr->GetItemTemplate(withdraw.entry);
+              uint32 toGive = bags->Store(temp, withdraw.amount);
+              if (toGive < withdraw.amount)
+                refused.push_back({withdraw.entry, withdraw.subclass,
+                                   withdraw.amount - toGive});
+              if (toGive)
+                bags->SendMessage(Acore::StringFormat("Withdrew {} x {}.",
+                                                      toGive, temp->Name1));
+            }
+          }
+          if (!refused.empty())
+          {
+            m_ledger.Deposit(owner, refused, {});
+            sReagentBankAudit->Record(owner, character, refused,
+                                      AUDIT_REFUND);
+          }
+          if (available && done)
+            done(true, found);
+        });
+  });
+}
+
+void ReagentBankEngine::WithdrawOne(std::shared_ptr<ReagentBankBags> bags,
+                                    uint32 entry, std::function<void()> done)
+{
+  WithdrawEntries(
+      bags, [entry](uint32 itemEntry, ReagentBankStoredItem const &)
+      { return itemEntry == entry; },
+      WITHDRAW_LIMIT_ONE, [done](bool, bool)
+      {
+        if (done)
+          done();
+      });
+}
+
+void ReagentBankEngine::WithdrawStack(std::shared_ptr<ReagentBankBags> bags,
+                                      uint32 entry, std::function<void()> done)
+{
+  WithdrawEntries(
+      bags, [entry](uint32 itemEntry, ReagentBankStoredItem const &)
+      { return itemEntry == entry; },
+      WITHDRAW_LIMIT_STACK, [done](bool, bool)
+      {
+        if (done)
+          done();
+      });
+}
+
+void ReagentBankEngine::WithdrawAllOfItem(
+    std::shared_ptr<ReagentBankBags> bags, uint32 entry,
+    std::function<void()> done)
+{
+  WithdrawEntries(
+      bags, [entry](uint32 itemEntry, ReagentBankStoredItem const &)
+      { return itemEntry == entry; },
+      WITHDRAW_LIMIT_ALL, [done](bool, bool)
+      {
+        if (done)
+          done();
+      });
+}
+
+void ReagentBankEngine::WithdrawAllInCategory(
+    std::shared_ptr<ReagentBankBags> bags, uint32 category,
+    std::function<void()> done)
+{
+  WithdrawEntries(
+      bags,
+      [category](uint32 entry, ReagentBankStoredItem const &)
+      { return GetReagentBankCategory(entry) == category; },
+      WITHDRAW_LIMIT_ALL, [bags, done](bool withdrawn, bool found)
+      {
+        if (!found)
+          bags->SendMessage("No reagents to withdraw in this category.");
+        else if (!withdrawn)
+          bags->SendMessage("No reagents withdrawn.");
+        if (done)
+          done();
+      });
+}
+
+void ReagentBankEngine::WithdrawAllReagents(
+    std::shared_ptr<ReagentBankBags> bags, std::function<void()> done)
+{
+  WithdrawEntries(
+      bags,
+      [](uint32 entry, ReagentBankStoredItem const &)
+      {
+        return sReagentBankCategories->IsCategory(
+            GetReagentBankCategory(entry));
+      },
+      WITHDRAW_LIMIT_ALL, [bags, done](bool withdrawn, bool found)
+      {
+        if (!found)
+          bags->SendMessage("No reagents to withdraw.");
+        else if (!withdrawn)
+          bags->SendMessage("No reagents withdrawn.");
+        if (done)
+          done();
+      });
+}
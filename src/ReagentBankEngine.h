@@ -0,0 +1,138 @@
+#ifndef AZEROTHCORE_REAGENTBANKENGINE_H
+#define AZEROTHCORE_REAGENTBANKENGINE_H
+#include "ItemTemplate.h"
+#include "Player.h"
+#include "ReagentBankLedger.h"
+#include "ReagentBankPlanner.h"
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+enum ReagentBankWithdrawLimit : uint8 {
+  WITHDRAW_LIMIT_ONE,
+  WITHDRAW_LIMIT_STACK,
+  WITHDRAW_LIMIT_ALL
+};
+
+// Gets whether anything was withdrawn and whether anything matched the
+// selection
+typedef std::function<void(bool withdrawn, bool found)>
+    ReagentBankWithdrawCallback;
+
+// What the engine needs of the bags it deposits from and withdraws to, and
+// of the client it reports to. The banker passes a player's; the tests in
+// tests/ bring bags of their own.
+class ReagentBankBags
+{
+public:
+  virtual ~ReagentBankBags() = default;
+
+  // False once the bags are gone, a withdraw still in flight then puts its
+  // items back into the bank. The other calls require the bags to be there.
+  virtual bool IsAvailable() const = 0;
+  virtual ReagentBankOwner GetOwner() const = 0;
+  // Character the audit records the changes for
+  virtual uint32 GetCharacter() const = 0;
+  // Removes the bankable items accepted by the filter and returns them as
+  // amounts to add to the bank; the guids of removed items go to itemGuids
+  virtual std::vector<ReagentBankItemAmount>
+  TakeReagents(std::function<bool(ItemTemplate const *)> const &filter,
+               std::vector<uint32> &itemGuids) = 0;
+  // The free space, gathered in a single pass
+  virtual ReagentBankBagPlanner PlanSpace() const = 0;
+  // Stores up to count new items and returns how many were stored
+  virtual uint32 Store(ItemTemplate const *itemTemplate, uint32 count) = 0;
+  virtual void SendNoSpace(ItemTemplate const *itemTemplate, uint32 count) = 0;
+  virtual void SendMessage(std::string const &text) = 0;
+};
+
+class ReagentBankPlayerBags : public ReagentBankBags
+{
+public:
+  explicit ReagentBankPlayerBags(Player *player)
+      : m_playerGuid(player->GetGUID())
+  {
+  }
+
+  // While the player is online
+  bool IsAvailable() const override { return GetPlayer() != nullptr; }
+  ReagentBankOwner GetOwner() const override;
+  uint32 GetCharacter() const override;
+  std::vector<ReagentBankItemAmount>
+  TakeReagents(std::function<bool(ItemTemplate const *)> const &filter,
+               std::vector<uint32> &itemGuids) override;
+  ReagentBankBagPlanner PlanSpace() const override;
+  uint32 Store(ItemTemplate const *itemTemplate, uint32 count) override;
+  void SendNoSpace(ItemTemplate const *itemTemplate, uint32 count) override;
+  void SendMessage(std::string const &text) override;
+
+private:
+  // Looked up on every call, the bags outlive asynchronous withdraws
+  Player *GetPlayer() const;
+
+  ObjectGuid m_playerGuid;
+};
+
+// Deposits and withdraws of the banker's menu, through a ledger, the
+// worldserver's for the banker. The menu only adds the throttling and closes
+// the gossip around these.
+// Only used from the world thread.
+class ReagentBankEngine
+{
+public:
+  explicit ReagentBankEngine(ReagentBankLedger &ledger) : m_ledger(ledger) {}
+
+  // The engine on sReagentBankLedger
+  static ReagentBankEngine *instance();
+
+  ReagentBankLedger &GetLedger() const { return m_ledger; }
+
+  // Deposits all reagents from the bags. Deposits only add to the stored
+  // amounts, so the bank is not read first. The callback runs once the
+  // deposit landed and only if there was anything to deposit.
+  std::vector<ReagentBankItemAmount>
+  DepositAllReagents(ReagentBankBags &bags,
+                     std::function<void()> callback = nullptr);
+  std::vector<ReagentBankItemAmount>
+  DepositAllReagentsForCategory(ReagentBankBags &bags, uint32 category);
+  void SendDepositFeedback(ReagentBankBags &bags,
+                           std::vector<ReagentBankItemAmount> const &deposits,
+                           char const *emptyMessage) const;
+
+  // Withdraws the selected stored entries with a single versioned write.
+  // The bank is read from the DB and the withdraw planned against the bags
+  // in one pass; when another worldserver wrote to the bank meanwhile, the
+  // bank is read again and the withdraw planned again. Nothing blocks: the
+  // items are stored in the callback of the commit, and done runs after
+  // that, unless the bags are gone by then.
+  void WithdrawEntries(
+      std::shared_ptr<ReagentBankBags> bags,
+      std::function<bool(uint32, ReagentBankStoredItem const &)> select,
+      ReagentBankWithdrawLimit limit, ReagentBankWithdrawCallback done);
+  void WithdrawOne(std::shared_ptr<ReagentBankBags> bags, uint32 entry,
+                   std::function<void()> done = nullptr);
+  void WithdrawStack(std::shared_ptr<ReagentBankBags> bags, uint32 entry,
+                     std::function<void()> done = nullptr);
+  void WithdrawAllOfItem(std::shared_ptr<ReagentBankBags> bags, uint32 entry,
+                         std::function<void()> done = nullptr);
+  void WithdrawAllInCategory(std::shared_ptr<ReagentBankBags> bags,
+                             uint32 category,
+                             std::function<void()> done = nullptr);
+  void WithdrawAllReagents(std::shared_ptr<ReagentBankBags> bags,
+                           std::function<void()> done = nullptr);
+
+private:
+  void WithdrawAttempt(
+      std::shared_ptr<ReagentBankBags> bags, ReagentBankOwner owner,
+      uint32 character,
+      std::function<bool(uint32, ReagentBankStoredItem const &)> select,
+      ReagentBankWithdrawLimit limit, ReagentBankWithdrawCallback done,
+      uint32 attempt);
+
+  ReagentBankLedger &m_ledger;
+};
+
+#define sReagentBankEngine ReagentBankEngine::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKENGINE_H
@@ -0,0 +1,267 @@
+#include "ReagentBankGuild.h"
+#include "Config.h"
+#include "GameTime.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankJournal.h"
+#include "Timer.h"
+#include <sstream>
+
+ReagentBankOwner GetReagentBankGuildOwner(Player *player)
+{
+  ReagentBankOwner owner;
+  owner.guid = player->GetGUID().GetCounter();
+  owner.guildId = player->GetGuildId();
+  return owner;
+}
+
+ReagentBankGuild *ReagentBankGuild::instance()
+{
+  static ReagentBankGuild instance;
+  return &instance;
+}
+
+void ReagentBankGuild::LoadConfig()
+{
+  m_enabled =
+      sConfigMgr->GetOption<bool>("ReagentBankAccount.Guild.Enable", false);
+  m_withdrawRank = sConfigMgr->GetOption<uint8>(
+      "ReagentBankAccount.Guild.WithdrawRank", DEFAULT_GUILD_WITHDRAW_RANK);
+  m_mergeInterval = sConfigMgr->GetOption<uint32>(
+      "ReagentBankAccount.Guild.MergeInterval", DEFAULT_GUILD_MERGE_INTERVAL);
+}
+
+bool ReagentBankGuild::CanWithdraw(Player *player) const
+{
+  // Rank 0 is the guild master, higher ranks have fewer rights
+  return player->GetGuildId() && player->GetRank() <= m_withdrawRank;
+}
+
+void ReagentBankGuild::AppendDeposit(
+    CharacterDatabaseTransaction trans, ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  trans->Append("INSERT INTO mod_reagent_bank_account_ops (token, account_id, guid, time) VALUES ({}, 0, {}, {})",
+                token, owner.guid, GameTime::GetGameTime().count());
+  // New rows only, so concurrent deposits never wait for each other
+  std::ostringstream values;
+  for (size_t i = 0; i < amounts.size(); ++i)
+    values << (i ? ", (" : "(") << owner.guildId << ", " << owner.guid << ", "
+           << amounts[i].entry << ", " << amounts[i].subclass << ", "
+           << amounts[i].amount << ")";
+  trans->Append("INSERT INTO mod_reagent_bank_account_guild_delta (guild_id, member_guid, item_entry, item_subclass, amount) VALUES {}",
+                values.str());
+}
+
+void ReagentBankGuild::Deposit(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts,
+    std::vector<uint32> const &itemGuids)
+{
+  uint64 token = sReagentBankLedger->NewToken();
+  sReagentBankJournal->Append(token, owner, amounts, itemGuids,
+                              [this, owner, amounts, token]()
+                              { CommitDeposit(owner, amounts, token); });
+}
+
+void ReagentBankGuild::CommitDeposit(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  AppendDeposit(trans, owner, amounts, token);
+  uint32 queued = getMSTime();
+  m_commitCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncCommitTransaction(trans).AfterComplete(
+          [owner, amounts, token, queued](bool success)
+          {
+            sReagentBankDatabasePool->RecordWait(queued);
+            if (success)
+              sReagentBankJournal->MarkCommitted(token);
+            else
+              sReagentBankLedger->RetryDeposit(owner, amounts, token);
+          }));
+}
+
+bool ReagentBankGuild::ApplyDeposit(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  AppendDeposit(trans, owner, amounts, token);
+  ReagentBankDatabase.DirectCommitTransaction(trans);
+  return true;
+}
+
+void ReagentBankGuild::AppendMerge(CharacterDatabaseTransaction trans,
+                                   uint64 token, std::vector<uint32> const &ids)
+{
+  std::ostringstream idList;
+  for (size_t i = 0; i < ids.size(); ++i)
+    idList << (i ? ", " : "") << ids[i];
+  // Claims the rows by primary key: a unique lookup locks the row found and
+  // no gap, so deposits appending deltas meanwhile never wait for the merge.
+  // A concurrent merge that read the same ids waits for them here and finds
+  // them claimed.
+  trans->Append("UPDATE mod_reagent_bank_account_guild_delta SET merge_token = {} WHERE id IN ({}) AND merge_token = 0",
+                token, idList.str());
+  trans->Append("INSERT INTO mod_reagent_bank_account_guild (guild_id, item_entry, item_subclass, amount) SELECT * FROM (SELECT guild_id, item_entry, MAX(item_subclass) AS item_subclass, SUM(amount) AS total FROM mod_reagent_bank_account_guild_delta WHERE merge_token = {} GROUP BY guild_id, item_entry) AS d ON DUPLICATE KEY UPDATE amount = amount + d.total",
+                token);
+  trans->Append("INSERT INTO mod_reagent_bank_account_guild_contribution (guild_id, guid, item_entry, deposited) SELECT * FROM (SELECT guild_id, member_guid, item_entry, SUM(amount) AS total FROM mod_reagent_bank_account_guild_delta WHERE merge_token = {} GROUP BY guild_id, member_guid, item_entry) AS d ON DUPLICATE KEY UPDATE deposited = deposited + d.total",
+                token);
+  trans->Append("DELETE FROM mod_reagent_bank_account_guild_delta WHERE merge_token = {}",
+                token);
+}
+
+void ReagentBankGuild::MergeAsync(uint32 guildId,
+                                  std::function<void()> callback)
+{
+  std::string guildFilter =
+      guildId ? " AND guild_id = " + std::to_string(guildId) : "";
+  // A plain read, the claim in AppendMerge decides which rows are whose
+  m_queryCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncQuery("SELECT id FROM mod_reagent_bank_account_guild_delta WHERE merge_token = 0" + guildFilter + " ORDER BY id LIMIT " + std::to_string(GUILD_MERGE_CHUNK_ROWS))
+          .WithCallback(
+              [this, callback](QueryResult result)
+              {
+                if (!result)
+                {
+                  callback();
+                  return;
+                }
+                std::vector<uint32> ids;
+                do
+                {
+                  ids.push_back((*result)[0].Get<uint32>());
+                } while (result->NextRow());
+                auto trans = ReagentBankDatabase.BeginTransaction();
+                AppendMerge(trans, sReagentBankLedger->NewToken(), ids);
+                uint32 queued = getMSTime();
+                m_commitCallbacks.AddCallback(
+                    ReagentBankDatabase.AsyncCommitTransaction(trans)
+                        .AfterComplete(
+                            [callback, queued](bool /*success*/)
+                            {
+                              sReagentBankDatabasePool->RecordWait(queued);
+                              callback();
+                            }));
+              }));
+}
+
+void ReagentBankGuild::LoadAsync(Player *player,
+                                 ReagentBankGuildLoadCallback callback)
+{
+  uint32 guildId = player->GetGuildId();
+  uint32 guid = player->GetGUID().GetCounter();
+  auto items = std::make_shared<ReagentBankItemMap>();
+  // One statement, so a merge landing meanwhile is seen entirely or not
+  player->GetSession()->GetQueryProcessor().AddCallback(
+      ReagentBankDatabase.AsyncQuery(
+          "SELECT item_entry, MAX(item_subclass), SUM(amount) FROM (SELECT item_entry, item_subclass, amount FROM mod_reagent_bank_account_guild WHERE guild_id = " + std::to_string(guildId) + " UNION ALL SELECT item_entry, item_subclass, amount FROM mod_reagent_bank_account_guild_delta WHERE guild_id = " + std::to_string(guildId) + ") t GROUP BY item_entry")
+          .WithChainingCallback(
+              [=](QueryCallback &next, QueryResult result)
+              {
+                if (result)
+                {
+                  do
+                  {
+                    Field *fields = result->Fetch();
+                    ReagentBankStoredItem &item =
+                        (*items)[fields[0].Get<uint32>()];
+                    item.subclass = fields[1].Get<uint32>();
+                    item.amount = fields[2].Get<uint32>();
+                  } while (result->NextRow());
+                }
+                next.SetNextQuery(ReagentBankDatabase.AsyncQuery(
+                    "SELECT SUM(deposited), SUM(withdrawn) FROM mod_reagent_bank_account_guild_contribution WHERE guild_id = " + std::to_string(guildId) + " AND guid = " + std::to_string(guid)));
+              })
+          .WithChainingCallback(
+              [=](QueryCallback & /*next*/, QueryResult result)
+              {
+                uint32 deposited = 0, withdrawn = 0;
+                if (result && !(*result)[0].IsNull())
+                {
+                  deposited = (*result)[0].Get<uint32>();
+                  withdrawn = (*result)[1].Get<uint32>();
+                }
+                callback(*items, deposited, withdrawn);
+              }));
+}
+
+void ReagentBankGuild::AppendTake(CharacterDatabaseTransaction trans,
+                                  ReagentBankOwner const &owner, uint32 entry,
+                                  uint32 amount, uint64 token)
+{
+  trans->Append("UPDATE mod_reagent_bank_account_guild SET amount = amount - {}, token = {} WHERE guild_id = {} AND item_entry = {} AND amount >= {}",
+                amount, token, owner.guildId, entry, amount);
+  trans->Append("INSERT INTO mod_reagent_bank_account_ops (token, account_id, guid, time) SELECT token, 0, {}, {} FROM mod_reagent_bank_account_guild WHERE guild_id = {} AND item_entry = {} AND token = {}",
+                owner.guid, GameTime::GetGameTime().count(), owner.guildId,
+                entry, token);
+  trans->Append("INSERT INTO mod_reagent_bank_account_guild_contribution (guild_id, guid, item_entry, withdrawn) SELECT {}, {}, {}, {} FROM mod_reagent_bank_account_ops WHERE token = {} ON DUPLICATE KEY UPDATE withdrawn = withdrawn + {}",
+                owner.guildId, owner.guid, entry, amount, token, amount);
+  trans->Append("DELETE FROM mod_reagent_bank_account_guild WHERE guild_id = {} AND item_entry = {} AND amount = 0",
+                owner.guildId, entry);
+}
+
+void ReagentBankGuild::TakeAsync(ReagentBankOwner const &owner, uint32 entry,
+                                 ReagentBankGuildTakePlan plan,
+                                 ReagentBankGuildTakeCallback callback)
+{
+  MergeAsync(owner.guildId, [=, this]()
+  {
+    m_queryCallbacks.AddCallback(
+        ReagentBankDatabase.AsyncQuery("SELECT amount FROM mod_reagent_bank_account_guild WHERE guild_id = " + std::to_string(owner.guildId) + " AND item_entry = " + std::to_string(entry))
+            .WithCallback(
+                [=, this](QueryResult result)
+                {
+                  uint32 stored = result ? (*result)[0].Get<uint32>() : 0;
+                  uint32 amount = plan(stored);
+                  if (!amount)
+                  {
+                    callback(0, false, stored);
+                    return;
+                  }
+                  uint64 token = sReagentBankLedger->NewToken();
+                  auto trans = ReagentBankDatabase.BeginTransaction();
+                  AppendTake(trans, owner, entry, amount, token);
+                  uint32 queued = getMSTime();
+                  m_commitCallbacks.AddCallback(
+                      ReagentBankDatabase.AsyncCommitTransaction(trans)
+                          .AfterComplete(
+                              [=, this](bool /*success*/)
+                              {
+                                sReagentBankDatabasePool->RecordWait(queued);
+                                // A commit reported as failed may have
+                                // landed after all; only the token tells
+                                m_queryCallbacks.AddCallback(
+                                    ReagentBankDatabase.AsyncQuery("SELECT 1 FROM mod_reagent_bank_account_ops WHERE token = " + std::to_string(token))
+                                        .WithCallback(
+                                            [=](QueryResult result)
+                                            {
+                                              callback(amount, result != nullptr,
+                                                       stored);
+                                            }));
+                              }));
+                }));
+  });
+}
+
+void ReagentBankGuild::Update(uint32 diff)
+{
+  m_queryCallbacks.ProcessReadyCallbacks();
+  m_commitCallbacks.ProcessReadyCallbacks();
+  if (!m_enabled)
+    return;
+
+  m_mergeTimer += diff;
+  if (m_mergeTimer < m_mergeInterval || m_merging)
+    return;
+  // The deltas keep; tried again after the next interval
+  if (sReagentBankDatabasePool->IsBusy())
+  {
+    m_mergeTimer = 0;
+    return;
+  }
+  m_mergeTimer = 0;
+  m_merging = true;
+  MergeAsync(0, [this]() { m_merging = false; });
+}
@@ -0,0 +1,107 @@
+#ifndef AZEROTHCORE_REAGENTBANKGUILD_H
+#define AZEROTHCORE_REAGENTBANKGUILD_H
+#include "AsyncCallbackProcessor.h"
+#include "DatabaseEnv.h"
+#include "Player.h"
+#include "QueryCallback.h"
+#include "ReagentBankLedger.h"
+#include <functional>
+#include <vector>
+
+#define DEFAULT_GUILD_WITHDRAW_RANK 1
+#define DEFAULT_GUILD_MERGE_INTERVAL 5000
+// Delta rows one merge claims, the rest waits for the next one
+#define GUILD_MERGE_CHUNK_ROWS 1000
+
+// Guild bank owner of the player, with the player as depositing member
+ReagentBankOwner GetReagentBankGuildOwner(Player *player);
+
+typedef std::function<void(ReagentBankItemMap const &, uint32 deposited,
+                           uint32 withdrawn)>
+    ReagentBankGuildLoadCallback;
+// Gets the stored amount of the entry and returns how much to take
+typedef std::function<uint32(uint32 stored)> ReagentBankGuildTakePlan;
+// Gets the amount planned, whether it was taken (false when another member
+// took it first) and the stored amount it was planned against
+typedef std::function<void(uint32 planned, bool taken, uint32 stored)>
+    ReagentBankGuildTakeCallback;
+
+// Reagent bank shared by a guild. Dozens of members deposit at the end of a
+// raid, so a deposit never updates the guild's rows: it only appends delta
+// rows to mod_reagent_bank_account_guild_delta. The deltas are merged into
+// mod_reagent_bank_account_guild and the per-member totals in
+// mod_reagent_bank_account_guild_contribution every MergeInterval ms. A
+// merge claims its delta rows by id first, so concurrent merges (also from
+// other worldservers) never count a row twice, and locks no gap deposits
+// append to.
+// Withdraws merge the guild first and take the amount with a conditional
+// decrement, which fails instead of going below zero. Nothing blocks the
+// world thread.
+// Only used from the world thread.
+class ReagentBankGuild
+{
+public:
+  static ReagentBankGuild *instance();
+
+  void LoadConfig();
+  bool IsEnabled() const { return m_enabled; }
+  bool CanWithdraw(Player *player) const;
+
+  // Appends the amounts as deltas. The destroyed items are journaled until
+  // the commit lands.
+  void Deposit(ReagentBankOwner const &owner,
+               std::vector<ReagentBankItemAmount> const &amounts,
+               std::vector<uint32> const &itemGuids);
+  // Appends the amounts under the given operation token, handing the
+  // deposit to the ledger's retries when the commit fails
+  void CommitDeposit(ReagentBankOwner const &owner,
+                     std::vector<ReagentBankItemAmount> const &amounts,
+                     uint64 token);
+  // Blocking: appends the amounts under the given operation token, used to
+  // replay the journal
+  bool ApplyDeposit(ReagentBankOwner const &owner,
+                    std::vector<ReagentBankItemAmount> const &amounts,
+                    uint64 token);
+
+  // Invokes the callback with the guild's reagents, pending deltas
+  // included, and the player's own contribution
+  void LoadAsync(Player *player, ReagentBankGuildLoadCallback callback);
+  // Merges the pending deltas of the owner's guild, reads the stored amount
+  // of the entry and takes what the plan returns for it (0 takes nothing)
+  // for the depositing member of owner. The callback always runs.
+  void TakeAsync(ReagentBankOwner const &owner, uint32 entry,
+                 ReagentBankGuildTakePlan plan,
+                 ReagentBankGuildTakeCallback callback);
+
+  // Merges the pending deltas of all guilds now and then
+  void Update(uint32 diff);
+
+private:
+  void AppendDeposit(CharacterDatabaseTransaction trans,
+                     ReagentBankOwner const &owner,
+                     std::vector<ReagentBankItemAmount> const &amounts,
+                     uint64 token);
+  // Merges the pending deltas of one guild, or of all when guildId is 0,
+  // up to GUILD_MERGE_CHUNK_ROWS of them; then runs the callback
+  void MergeAsync(uint32 guildId, std::function<void()> callback);
+  // Merges the delta rows with the given ids
+  void AppendMerge(CharacterDatabaseTransaction trans, uint64 token,
+                   std::vector<uint32> const &ids);
+  // The conditional decrement of a withdraw, under the operation token
+  void AppendTake(CharacterDatabaseTransaction trans,
+                  ReagentBankOwner const &owner, uint32 entry, uint32 amount,
+                  uint64 token);
+
+  bool m_enabled = false;
+  uint8 m_withdrawRank = DEFAULT_GUILD_WITHDRAW_RANK;
+  uint32 m_mergeInterval = DEFAULT_GUILD_MERGE_INTERVAL;
+  uint32 m_mergeTimer = 0;
+  bool m_merging = false;
+
+  QueryCallbackProcessor m_queryCallbacks;
+  AsyncCallbackProcessor<TransactionCallback> m_commitCallbacks;
+};
+
+#define sReagentBankGuild ReagentBankGuild::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKGUILD_H
@@ -0,0 +1,288 @@
+#include "ReagentBankJournal.h"
+#include "Config.h"
+#include "GameTime.h"
+#include "ReagentBankAudit.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankGuild.h"
+#include "Log.h"
+#include "StringConvert.h"
+#include "Tokenize.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+ReagentBankJournal *ReagentBankJournal::instance()
+{
+  static ReagentBankJournal instance;
+  return &instance;
+}
+
+void ReagentBankJournal::LoadConfig()
+{
+  m_enabled =
+      sConfigMgr->GetOption<bool>("ReagentBankAccount.Journal.Enable", true);
+  m_path = sConfigMgr->GetOption<std::string>("ReagentBankAccount.Journal.Path",
+                                              "reagent_bank.journal");
+  m_groupCommitInterval = sConfigMgr->GetOption<uint32>(
+      "ReagentBankAccount.Journal.GroupCommitInterval",
+      DEFAULT_JOURNAL_GROUP_COMMIT_INTERVAL);
+}
+
+static void SyncFile(FILE *file)
+{
+  fflush(file);
+#ifdef _WIN32
+  _commit(_fileno(file));
+#else
+  fsync(fileno(file));
+#endif
+}
+
+void ReagentBankJournal::Open(char const *mode)
+{
+  if (m_file)
+    fclose(m_file);
+  m_file = fopen(m_path.c_str(), mode);
+  if (!m_file)
+    LOG_ERROR("module", "Reagent bank: cannot open journal {}", m_path);
+}
+
+// <token> <account_id> <guid> <count> {<entry> <subclass> <amount>}
+//   <count> {<item guid>} <guild_id>
+// Lines written before guild banks existed have no guild_id.
+bool ReagentBankJournal::Parse(std::string const &line, Record &record)
+{
+  std::vector<std::string_view> tokens = Acore::Tokenize(line, ' ', false);
+  size_t index = 0;
+  auto next = [&](auto &value)
+  {
+    if (index >= tokens.size())
+      return false;
+    auto parsed = Acore::StringTo<std::remove_reference_t<decltype(value)>>(
+        tokens[index++]);
+    if (!parsed)
+      return false;
+    value = *parsed;
+    return true;
+  };
+
+  uint32 count = 0;
+  if (!next(record.token) || !next(record.owner.accountId) ||
+      !next(record.owner.guid) || !next(count))
+    return false;
+  record.amounts.resize(count);
+  for (ReagentBankItemAmount &amount : record.amounts)
+    if (!next(amount.entry) || !next(amount.subclass) || !next(amount.amount))
+      return false;
+  if (!next(count))
+    return false;
+  record.itemGuids.resize(count);
+  for (uint32 &itemGuid : record.itemGuids)
+    if (!next(itemGuid))
+      return false;
+  if (index < tokens.size() && !next(record.owner.guildId))
+    return false;
+  return index == tokens.size();
+}
+
+bool ReagentBankJournal::IsApplied(Record const &record)
+{
+  if (ReagentBankDatabase.Query("SELECT 1 FROM mod_reagent_bank_account_ops WHERE token = {}",
+                              record.token))
+    return true;
+  if (record.itemGuids.empty())
+    return false;
+  std::ostringstream guids;
+  for (size_t i = 0; i < record.itemGuids.size(); ++i)
+    guids << (i ? "," : "") << record.itemGuids[i];
+  return ReagentBankDatabase.Query("SELECT 1 FROM item_instance WHERE guid IN ({}) LIMIT 1",
+                                 guids.str()) != nullptr;
+}
+
+void ReagentBankJournal::Replay()
+{
+  if (!m_enabled)
+    return;
+
+  uint32 replayed = 0;
+  std::vector<Record> failed;
+  std::ifstream in(m_path);
+  std::string line;
+  while (std::getline(in, line))
+  {
+    Record record;
+    // A torn last line was never acknowledged to anyone
+    if (!Parse(line, record))
+    {
+      LOG_WARN("module", "Reagent bank: skipping unreadable journal line '{}'",
+               line);
+      continue;
+    }
+    if (IsApplied(record))
+      continue;
+    bool applied =
+        record.owner.guildId
+            ? sReagentBankGuild->ApplyDeposit(record.owner, record.amounts,
+                                              record.token)
+            : sReagentBankLedger->ApplyDeposit(record.owner, record.amounts,
+                                               record.token);
+    if (!applied)
+    {
+      LOG_ERROR("module", "Reagent bank journal: could not replay deposit {}, retrying it",
+                record.token);
+      failed.push_back(record);
+      continue;
+    }
+    sReagentBankAudit->Record(record.owner, 0, record.amounts, AUDIT_REPLAY);
+    ++replayed;
+  }
+  in.close();
+
+  if (replayed)
+    LOG_INFO("module", ">> Replayed {} reagent bank deposits from {}",
+             replayed, m_path);
+  // Everything else in it is in the DB now
+  Open("wb");
+  for (Record const &record : failed)
+    Append(record.token, record.owner, record.amounts, record.itemGuids,
+           [record]()
+           {
+             sReagentBankLedger->RetryDeposit(record.owner, record.amounts,
+                                              record.token);
+           });
+  // The old file is gone, the failed records must not wait for the timer
+  Flush();
+}
+
+void ReagentBankJournal::Append(
+    uint64 token, ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts,
+    std::vector<uint32> const &itemGuids, std::function<void()> commit)
+{
+  if (!m_file)
+  {
+    commit();
+    return;
+  }
+  std::ostringstream line;
+  line << token << ' ' << owner.accountId << ' ' << owner.guid << ' '
+       << amounts.size();
+  for (ReagentBankItemAmount const &amount : amounts)
+    line << ' ' << amount.entry << ' ' << amount.subclass << ' '
+         << amount.amount;
+  line << ' ' << itemGuids.size();
+  for (uint32 itemGuid : itemGuids)
+    line << ' ' << itemGuid;
+  line << ' ' << owner.guildId << '\n';
+  PendingRecord &record = m_pending[token];
+  record.line = line.str();
+  record.time = GameTime::GetGameTime().count();
+  record.commit = commit;
+}
+
+void ReagentBankJournal::MarkCommitted(uint64 token)
+{
+  auto it = m_pending.find(token);
+  if (it == m_pending.end())
+    return;
+  if (it->second.written)
+    ++m_landedInFile;
+  m_pending.erase(it);
+}
+
+time_t ReagentBankJournal::GetOldestTime() const
+{
+  time_t oldest = 0;
+  for (auto const &itr : m_pending)
+    if (!oldest || itr.second.time < oldest)
+      oldest = itr.second.time;
+  return oldest;
+}
+
+void ReagentBankJournal::Update(uint32 diff)
+{
+  if (!m_enabled)
+    return;
+  m_timer += diff;
+  if (m_timer < m_groupCommitInterval)
+    return;
+  m_timer = 0;
+  Flush();
+}
+
+void ReagentBankJournal::Flush()
+{
+  if (!m_file)
+    return;
+
+  // Taken before the records are marked written
+  std::vector<std::function<void()>> commits;
+  for (auto &itr : m_pending)
+  {
+    if (itr.second.written || !itr.second.commit)
+      continue;
+    commits.push_back(std::move(itr.second.commit));
+    itr.second.commit = nullptr;
+  }
+
+  // A record whose commit keeps failing holds back none of the others
+  if (!m_landedInFile || !Rewrite())
+  {
+    std::string buffer;
+    for (auto &itr : m_pending)
+    {
+      if (itr.second.written)
+        continue;
+      buffer += itr.second.line;
+      itr.second.written = true;
+    }
+    if (!buffer.empty())
+    {
+      fwrite(buffer.data(), 1, buffer.size(), m_file);
+      SyncFile(m_file);
+    }
+  }
+
+  // Only now may the deposits reach the DB
+  for (std::function<void()> const &commit : commits)
+    commit();
+}
+
+bool ReagentBankJournal::Rewrite()
+{
+  std::string path = m_path + ".tmp";
+  FILE *file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    LOG_ERROR("module", "Reagent bank: cannot open journal {}", path);
+    return false;
+  }
+  for (auto const &itr : m_pending)
+    fwrite(itr.second.line.data(), 1, itr.second.line.size(), file);
+  SyncFile(file);
+  fclose(file);
+
+  // The rename replaces the file in one step, a crash leaves either one
+  fclose(m_file);
+  m_file = nullptr;
+  std::error_code error;
+  std::filesystem::rename(path, m_path, error);
+  Open("ab");
+  if (error)
+  {
+    // The old file is still complete up to the records not written yet
+    LOG_ERROR("module", "Reagent bank: cannot replace journal {}: {}", m_path,
+              error.message());
+    return false;
+  }
+  for (auto &itr : m_pending)
+    itr.second.written = true;
+  m_landedInFile = 0;
+  return true;
+}
@@ -0,0 +1,92 @@
+#ifndef AZEROTHCORE_REAGENTBANKJOURNAL_H
+#define AZEROTHCORE_REAGENTBANKJOURNAL_H
+#include "ReagentBankLedger.h"
+#include <cstdio>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#define DEFAULT_JOURNAL_GROUP_COMMIT_INTERVAL 50
+
+// Append-only local journal of the deposits that are committed to the DB
+// asynchronously. The items are destroyed before the commit lands, so a
+// crash in between would lose them; on startup the journal is replayed:
+//  - deposits whose operation token is in mod_reagent_bank_account_ops
+//    made it to the DB and are skipped
+//  - deposits whose destroyed items still exist in item_instance never had
+//    their removal saved either, the player still owns them
+//  - all others are applied again with their original token
+// Records are written and fsync'ed in groups every GroupCommitInterval ms,
+// and a deposit is only committed once its record is on disk; otherwise a
+// crash after a fast commit but before the flush could still lose items.
+// Once some of the written ones landed, the file is replaced by one holding
+// only the records still pending, so it never outlives the operation tokens
+// that tell whether its records were applied.
+class ReagentBankJournal
+{
+public:
+  static ReagentBankJournal *instance();
+
+  void LoadConfig();
+  bool IsEnabled() const { return m_enabled; }
+
+  // Must run before the world accepts players
+  void Replay();
+
+  // Queues the record for the next group flush. commit runs once the record
+  // is on disk, right away when there is no journal.
+  void Append(uint64 token, ReagentBankOwner const &owner,
+              std::vector<ReagentBankItemAmount> const &amounts,
+              std::vector<uint32> const &itemGuids,
+              std::function<void()> commit);
+  void MarkCommitted(uint64 token);
+  // Append time of the oldest record still pending, 0 when there is none.
+  // Operation tokens from then on must be kept for the replay.
+  time_t GetOldestTime() const;
+
+  void Update(uint32 diff);
+  // Writes and fsyncs the queued records, then starts their commits
+  void Flush();
+
+private:
+  struct Record
+  {
+    uint64 token = 0;
+    ReagentBankOwner owner;
+    std::vector<ReagentBankItemAmount> amounts;
+    std::vector<uint32> itemGuids;
+  };
+
+  static bool Parse(std::string const &line, Record &record);
+  struct PendingRecord
+  {
+    std::string line;
+    time_t time = 0;
+    // Already in the file
+    bool written = false;
+    // Held until the record is written
+    std::function<void()> commit;
+  };
+
+  static bool IsApplied(Record const &record);
+  void Open(char const *mode);
+  // Replaces the file with the pending records, false when it could not
+  bool Rewrite();
+
+  bool m_enabled = false;
+  std::string m_path;
+  uint32 m_groupCommitInterval = DEFAULT_JOURNAL_GROUP_COMMIT_INTERVAL;
+  uint32 m_timer = 0;
+
+  FILE *m_file = nullptr;
+  // token -> appended record whose DB commit has not landed yet
+  std::map<uint64, PendingRecord> m_pending;
+  // Records in the file whose commit landed since it was last rewritten
+  uint32 m_landedInFile = 0;
+};
+
+#define sReagentBankJournal ReagentBankJournal::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKJOURNAL_H
@@ -0,0 +1,734 @@
+#include "ReagentBankLedger.h"
+#include "GameTime.h"
+#include "Random.h"
+#include "ReagentBankAccount.h"
+#include "ReagentBankDatabase.h"
+#include "ReagentBankGuild.h"
+#include "ReagentBankJournal.h"
+#include "ReagentBankPacked.h"
+#include "StringFormat.h"
+#include "Timer.h"
+#include "Util.h"
+#include <algorithm>
+#include <sstream>
+
+ReagentBankOwner GetReagentBankOwner(Player *player)
+{
+  ReagentBankOwner owner;
+  if (g_accountWideReagentBank)
+    owner.accountId = player->GetSession()->GetAccountId();
+  else
+    owner.guid = player->GetGUID().GetRawValue();
+  return owner;
+}
+
+ReagentBankLedger *ReagentBankLedger::instance()
+{
+  static ReagentBankLedger instance;
+  return &instance;
+}
+
+void ReagentBankLedger::LoadConfig()
+{
+  m_target = ReagentBankStorageFormat(sConfigMgr->GetOption<uint8>(
+      "ReagentBankAccount.Storage", REAGENT_BANK_STORAGE_ROWS));
+}
+
+void ReagentBankLedger::Initialize()
+{
+  m_tokenBase = uint64(urand(1, 0xFFFFFFFF)) << 32;
+  m_tokenCounter = 0;
+
+  // The banks stay in the format they are in until ConvertStorage moved them
+  QueryResult result = ReagentBankDatabase.Query(
+      "SELECT format FROM mod_reagent_bank_account_storage WHERE id = 0");
+  m_storage = ReagentBankStorageFormat(
+      result ? (*result)[0].Get<uint8>() : REAGENT_BANK_STORAGE_ROWS);
+  // A conversion cut short left banks in the other format's table
+  bool leftover = m_target == REAGENT_BANK_STORAGE_PACKED
+                      ? ReagentBankDatabase.Query("SELECT 1 FROM mod_reagent_bank_account LIMIT 1") != nullptr
+                      : ReagentBankDatabase.Query("SELECT 1 FROM mod_reagent_bank_account_packed LIMIT 1") != nullptr;
+  m_convert = m_storage != m_target || leftover;
+}
+
+uint64 ReagentBankLedger::NewToken()
+{
+  return m_tokenBase | ++m_tokenCounter;
+}
+
+std::string ReagentBankLedger::GetLoadQuery(ReagentBankTables const &tables,
+                                            ReagentBankStorageFormat storage,
+                                            ReagentBankOwner const &owner)
+{
+  // One statement, so the version and the amounts come from one snapshot.
+  // Every bank with rows has a version row.
+  if (storage == REAGENT_BANK_STORAGE_PACKED)
+    return Acore::StringFormat("SELECT v.version, p.data FROM {} v LEFT JOIN {} p ON p.account_id = v.account_id AND p.guid = v.guid WHERE v.account_id = {} AND v.guid = {}",
+                               tables.version, tables.packed, owner.accountId,
+                               owner.guid);
+  return Acore::StringFormat("SELECT v.version, a.item_entry, a.item_subclass, a.amount FROM {} v LEFT JOIN {} a ON a.account_id = v.account_id AND a.guid = v.guid WHERE v.account_id = {} AND v.guid = {}",
+                             tables.version, tables.rows, owner.accountId,
+                             owner.guid);
+}
+
+std::string ReagentBankLedger::GetLoadQuery(ReagentBankOwner const &owner) const
+{
+  return GetLoadQuery(ReagentBankTables(), m_storage, owner);
+}
+
+uint32 ReagentBankLedger::ReadBank(ReagentBankStorageFormat storage,
+                                   QueryResult result, ReagentBankItemMap &items)
+{
+  items.clear();
+  if (!result)
+    return 0;
+  uint32 version = 0;
+  if (storage == REAGENT_BANK_STORAGE_PACKED)
+  {
+    Field *fields = result->Fetch();
+    version = fields[0].Get<uint32>();
+    if (!fields[1].IsNull() &&
+        !DecodeReagentBank(fields[1].Get<Binary>(), items))
+    {
+      LOG_ERROR("module", "Reagent bank: unreadable packed bank (version {}), refusing writes to it",
+                version);
+      items.clear();
+      return UNREADABLE_VERSION;
+    }
+    return version;
+  }
+  do
+  {
+    Field *fields = result->Fetch();
+    version = fields[0].Get<uint32>();
+    if (fields[1].IsNull())
+      continue;
+    ReagentBankStoredItem &item = items[fields[1].Get<uint32>()];
+    item.subclass = fields[2].Get<uint32>();
+    item.amount = fields[3].Get<uint32>();
+  } while (result->NextRow());
+  return version;
+}
+
+void ReagentBankLedger::Fill(OwnerState &state, QueryResult result) const
+{
+  state.version = ReadBank(m_storage, result, state.items);
+}
+
+ReagentBankItemMap const *
+ReagentBankLedger::GetItems(ReagentBankOwner const &owner) const
+{
+  auto it = m_owners.find(owner.GetKey());
+  return it != m_owners.end() ? &it->second : nullptr;
+}
+
+bool ReagentBankLedger::CanCache(uint64 key, uint64 issued) const
+{
+  auto lastWrite = m_lastWrite.find(key);
+  if (lastWrite != m_lastWrite.end() && lastWrite->second > issued)
+    return false;
+  return !m_inFlight.count(key) && !m_writesInFlight.count(key);
+}
+
+void ReagentBankLedger::LoadAsync(Player *player,
+                                  ReagentBankLoadCallback callback)
+{
+  ReagentBankOwner owner = GetReagentBankOwner(player);
+  if (ReagentBankItemMap const *items = GetItems(owner))
+  {
+    callback(*items);
+    return;
+  }
+  uint64 key = owner.GetKey();
+  uint64 issued = m_writeSerial;
+  uint32 queued = getMSTime();
+  player->GetSession()->GetQueryProcessor().AddCallback(
+      ReagentBankDatabase.AsyncQuery(GetLoadQuery(owner))
+          .WithCallback(
+              [=, this](QueryResult result)
+              {
+                sReagentBankDatabasePool->RecordWait(queued);
+                // Another load filled the cache meanwhile
+                if (ReagentBankItemMap const *items = GetItems(owner))
+                {
+                  callback(*items);
+                  return;
+                }
+                // A write landed while the query was in flight, read again
+                auto lastWrite = m_lastWrite.find(key);
+                if (lastWrite != m_lastWrite.end() &&
+                    lastWrite->second > issued)
+                {
+                  LoadAsync(player, callback);
+                  return;
+                }
+                OwnerState state;
+                Fill(state, result);
+                // Deposits of an earlier visit may still be in flight; the
+                // read is shown, but not kept
+                if (!CanCache(key, issued))
+                {
+                  callback(state.items);
+                  return;
+                }
+                ReagentBankItemMap &items = m_owners[key];
+                items = std::move(state.items);
+                callback(items);
+              }));
+}
+
+void ReagentBankLedger::ReadAsync(ReagentBankOwner const &owner,
+                                  ReagentBankReadCallback callback)
+{
+  uint64 key = owner.GetKey();
+  uint64 issued = m_writeSerial;
+  uint32 queued = getMSTime();
+  m_queryCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncQuery(GetLoadQuery(owner))
+          .WithCallback(
+              [=, this](QueryResult result)
+              {
+                sReagentBankDatabasePool->RecordWait(queued);
+                OwnerState state;
+                Fill(state, result);
+                // Picks up the writes of other worldservers; banks of
+                // players no longer online are not cached again
+                auto it = m_owners.find(key);
+                if (it != m_owners.end() &&
+                    state.version != UNREADABLE_VERSION &&
+                    CanCache(key, issued))
+                  it->second = state.items;
+                callback(state.items, state.version);
+              }));
+}
+
+uint32 ReagentBankLedger::Read(ReagentBankOwner const &owner,
+                               ReagentBankItemMap &items)
+{
+  OwnerState state;
+  Fill(state, ReagentBankDatabase.Query(GetLoadQuery(owner)));
+  items = std::move(state.items);
+  return state.version;
+}
+
+void ReagentBankLedger::Deposit(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts,
+    std::vector<uint32> const &itemGuids, std::function<void()> callback)
+{
+  AddToCache(owner, amounts);
+  QueuedDeposit deposit;
+  deposit.owner = owner;
+  deposit.amounts = amounts;
+  deposit.token = NewToken();
+  deposit.callback = callback;
+  ++m_inFlight[owner.GetKey()];
+  sReagentBankJournal->Append(deposit.token, owner, amounts, itemGuids,
+                              [this, deposit]() { CommitDeposit(deposit); });
+}
+
+void ReagentBankLedger::CommitDeposit(QueuedDeposit const &deposit)
+{
+  if (m_storage == REAGENT_BANK_STORAGE_PACKED)
+  {
+    CommitPackedDeposit(deposit);
+    return;
+  }
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  AppendDeposit(trans, deposit.owner, deposit.amounts, deposit.token);
+  uint32 queued = getMSTime();
+  m_depositCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncCommitTransaction(trans).AfterComplete(
+          [this, deposit, queued](bool success)
+          {
+            sReagentBankDatabasePool->RecordWait(queued);
+            if (success)
+              Landed(deposit);
+            else
+              QueueRetry(deposit);
+          }));
+}
+
+void ReagentBankLedger::CommitPackedDeposit(QueuedDeposit const &deposit)
+{
+  // Read, added to and written back like a withdraw, but from the worker
+  // threads: the world thread only runs the callbacks
+  uint32 queued = getMSTime();
+  m_queryCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncQuery(GetLoadQuery(deposit.owner))
+          .WithCallback(
+              [this, deposit, queued](QueryResult result)
+              {
+                sReagentBankDatabasePool->RecordWait(queued);
+                OwnerState state;
+                Fill(state, result);
+                if (state.version == UNREADABLE_VERSION)
+                {
+                  QueueRetry(deposit);
+                  return;
+                }
+                for (ReagentBankItemAmount const &amount : deposit.amounts)
+                {
+                  ReagentBankStoredItem &item = state.items[amount.entry];
+                  item.subclass = amount.subclass;
+                  item.amount += amount.amount;
+                }
+                auto trans = ReagentBankDatabase.BeginTransaction();
+                AppendVersionBump(trans, ReagentBankTables(), deposit.owner,
+                                  state.version, deposit.token);
+                AppendPackedData(trans, ReagentBankTables(), deposit.owner,
+                                 state.items, deposit.token);
+                uint32 committed = getMSTime();
+                m_depositCallbacks.AddCallback(
+                    ReagentBankDatabase.AsyncCommitTransaction(trans)
+                        .AfterComplete(
+                            [this, deposit, committed](bool success)
+                            {
+                              sReagentBankDatabasePool->RecordWait(committed);
+                              if (success)
+                                ConfirmPackedDeposit(deposit);
+                              else
+                                QueueRetry(deposit);
+                            }));
+              }));
+}
+
+void ReagentBankLedger::ConfirmPackedDeposit(QueuedDeposit const &deposit)
+{
+  m_queryCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncQuery("SELECT 1 FROM mod_reagent_bank_account_ops WHERE token = " + std::to_string(deposit.token))
+          .WithCallback(
+              [this, deposit](QueryResult result)
+              {
+                if (result)
+                {
+                  Landed(deposit);
+                  return;
+                }
+                // The version moved between the read and the write; read
+                // again right away, a few times, before falling back to the
+                // slower retries
+                QueuedDeposit retry = deposit;
+                if (++retry.attempts < MAX_WRITE_ATTEMPTS)
+                  CommitPackedDeposit(retry);
+                else
+                  QueueRetry(deposit);
+              }));
+}
+
+void ReagentBankLedger::Landed(QueuedDeposit const &deposit)
+{
+  sReagentBankJournal->MarkCommitted(deposit.token);
+  auto it = m_inFlight.find(deposit.owner.GetKey());
+  if (it != m_inFlight.end() && !--it->second)
+    m_inFlight.erase(it);
+  if (deposit.callback)
+    deposit.callback();
+}
+
+void ReagentBankLedger::RetryDeposit(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token,
+    std::function<void()> callback)
+{
+  QueuedDeposit deposit;
+  deposit.owner = owner;
+  deposit.amounts = amounts;
+  deposit.token = token;
+  deposit.callback = callback;
+  if (!owner.guildId)
+    ++m_inFlight[owner.GetKey()];
+  QueueRetry(deposit);
+}
+
+void ReagentBankLedger::QueueRetry(QueuedDeposit const &deposit)
+{
+  LOG_ERROR("module", "Reagent bank: commit of deposit {} to bank {}/{}/{} failed, retrying it",
+            deposit.token, deposit.owner.accountId, deposit.owner.guid,
+            deposit.owner.guildId);
+  m_retries.push_back(deposit);
+}
+
+void ReagentBankLedger::Update(uint32 diff)
+{
+  m_depositCallbacks.ProcessReadyCallbacks();
+  m_queryCallbacks.ProcessReadyCallbacks();
+
+  m_retryTimer += diff;
+  if (m_retryTimer < DEPOSIT_RETRY_INTERVAL)
+    return;
+  m_retryTimer = 0;
+  std::vector<QueuedDeposit> retries;
+  retries.swap(m_retries);
+  for (QueuedDeposit const &deposit : retries)
+  {
+    // A commit reported as failed may have landed after all, and must not
+    // land a second time
+    m_queryCallbacks.AddCallback(
+        ReagentBankDatabase.AsyncQuery("SELECT 1 FROM mod_reagent_bank_account_ops WHERE token = " + std::to_string(deposit.token))
+            .WithCallback(
+                [this, deposit](QueryResult result)
+                {
+                  if (result)
+                    Landed(deposit);
+                  else if (deposit.owner.guildId)
+                    sReagentBankGuild->CommitDeposit(
+                        deposit.owner, deposit.amounts, deposit.token);
+                  else
+                    CommitDeposit(deposit);
+                }));
+  }
+}
+
+bool ReagentBankLedger::DepositVersioned(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  for (uint32 attempt = 0; attempt < MAX_WRITE_ATTEMPTS; ++attempt)
+  {
+    ReagentBankItemMap items;
+    uint32 version = Read(owner, items);
+    std::vector<ReagentBankItemAmount> totals;
+    for (ReagentBankItemAmount const &deposit : amounts)
+    {
+      auto it = items.find(deposit.entry);
+      totals.push_back({deposit.entry, deposit.subclass,
+                        (it != items.end() ? it->second.amount : 0) +
+                            deposit.amount});
+    }
+    if (CommitVersioned(owner, version, items, totals, token))
+      return true;
+  }
+  return false;
+}
+
+bool ReagentBankLedger::ApplyDeposit(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  if (m_storage == REAGENT_BANK_STORAGE_PACKED)
+    return DepositVersioned(owner, amounts, token);
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  AppendDeposit(trans, owner, amounts, token);
+  ReagentBankDatabase.DirectCommitTransaction(trans);
+  AddToCache(owner, amounts);
+  return true;
+}
+
+void ReagentBankLedger::AppendDeposit(
+    CharacterDatabaseTransaction trans, ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  // The version row goes first so all bank transactions lock in one order
+  trans->Append("INSERT INTO mod_reagent_bank_account_version (account_id, guid, version) VALUES ({}, {}, 1) ON DUPLICATE KEY UPDATE version = version + 1",
+                owner.accountId, owner.guid);
+  trans->Append("INSERT INTO mod_reagent_bank_account_ops (token, account_id, guid, time) VALUES ({}, {}, {}, {})",
+                token, owner.accountId, owner.guid,
+                GameTime::GetGameTime().count());
+  for (ReagentBankItemAmount const &deposit : amounts)
+    trans->Append("INSERT INTO mod_reagent_bank_account (account_id, guid, item_entry, item_subclass, amount) VALUES ({}, {}, {}, {}, {}) ON DUPLICATE KEY UPDATE amount = amount + {}",
+                  owner.accountId, owner.guid, deposit.entry, deposit.subclass,
+                  deposit.amount, deposit.amount);
+}
+
+void ReagentBankLedger::AddToCache(
+    ReagentBankOwner const &owner,
+    std::vector<ReagentBankItemAmount> const &amounts)
+{
+  uint64 key = owner.GetKey();
+  m_lastWrite[key] = ++m_writeSerial;
+  auto it = m_owners.find(key);
+  if (it == m_owners.end())
+    return;
+  for (ReagentBankItemAmount const &deposit : amounts)
+  {
+    ReagentBankStoredItem &item = it->second[deposit.entry];
+    item.subclass = deposit.subclass;
+    item.amount += deposit.amount;
+  }
+}
+
+void ReagentBankLedger::ApplyToCache(
+    ReagentBankOwner const &owner, ReagentBankItemMap const &items,
+    std::vector<ReagentBankItemAmount> const &amounts)
+{
+  uint64 key = owner.GetKey();
+  m_lastWrite[key] = ++m_writeSerial;
+  auto it = m_owners.find(key);
+  if (it == m_owners.end())
+    return;
+  for (ReagentBankItemAmount const &write : amounts)
+  {
+    auto planned = items.find(write.entry);
+    uint32 before = planned != items.end() ? planned->second.amount : 0;
+    ReagentBankStoredItem &item = it->second[write.entry];
+    item.subclass = write.subclass;
+    item.amount = item.amount + write.amount > before
+                      ? item.amount + write.amount - before
+                      : 0;
+    if (!item.amount)
+      it->second.erase(write.entry);
+  }
+}
+
+void ReagentBankLedger::AppendVersionBump(CharacterDatabaseTransaction trans,
+                                          ReagentBankTables const &tables,
+                                          ReagentBankOwner const &owner,
+                                          uint32 expectedVersion, uint64 token)
+{
+  trans->Append("INSERT IGNORE INTO {} (account_id, guid, version) VALUES ({}, {}, 0)",
+                tables.version, owner.accountId, owner.guid);
+  // Holds the version row until commit, so nobody can write in between
+  trans->Append("UPDATE {} SET version = version + 1, token = {} WHERE account_id = {} AND guid = {} AND version = {}",
+                tables.version, token, owner.accountId, owner.guid,
+                expectedVersion);
+  trans->Append("INSERT INTO {} (token, account_id, guid, time) SELECT token, account_id, guid, {} FROM {} WHERE account_id = {} AND guid = {} AND token = {}",
+                tables.ops, GameTime::GetGameTime().count(), tables.version,
+                owner.accountId, owner.guid, token);
+}
+
+void ReagentBankLedger::AppendPackedData(CharacterDatabaseTransaction trans,
+                                         ReagentBankTables const &tables,
+                                         ReagentBankOwner const &owner,
+                                         ReagentBankItemMap const &items,
+                                         uint64 token)
+{
+  if (items.empty())
+  {
+    trans->Append("DELETE FROM {} WHERE account_id = {} AND guid = {} AND EXISTS (SELECT 1 FROM {} WHERE token = {})",
+                  tables.packed, owner.accountId, owner.guid, tables.ops,
+                  token);
+    return;
+  }
+  std::string data = ByteArrayToHexStr(EncodeReagentBank(items));
+  trans->Append("INSERT INTO {} (account_id, guid, data) SELECT {}, {}, X'{}' FROM {} WHERE token = {} ON DUPLICATE KEY UPDATE data = X'{}'",
+                tables.packed, owner.accountId, owner.guid, data, tables.ops,
+                token, data);
+}
+
+void ReagentBankLedger::AppendVersionedWrite(
+    CharacterDatabaseTransaction trans, ReagentBankTables const &tables,
+    ReagentBankStorageFormat storage, ReagentBankOwner const &owner,
+    uint32 expectedVersion, ReagentBankItemMap const &items,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  AppendVersionBump(trans, tables, owner, expectedVersion, token);
+  if (storage == REAGENT_BANK_STORAGE_PACKED)
+  {
+    // The whole blob is rewritten from the bank the write was planned
+    // against, which the version check guarantees to be the one at
+    // expectedVersion
+    ReagentBankItemMap written = items;
+    for (ReagentBankItemAmount const &write : amounts)
+    {
+      if (write.amount == 0)
+        written.erase(write.entry);
+      else
+        written[write.entry] = {write.subclass, write.amount};
+    }
+    AppendPackedData(trans, tables, owner, written, token);
+    return;
+  }
+  for (ReagentBankItemAmount const &write : amounts)
+  {
+    if (write.amount == 0)
+      trans->Append("DELETE FROM {} WHERE account_id = {} AND guid = {} AND item_entry = {} AND EXISTS (SELECT 1 FROM {} WHERE token = {})",
+                    tables.rows, owner.accountId, owner.guid, write.entry,
+                    tables.ops, token);
+    else
+      trans->Append("INSERT INTO {} (account_id, guid, item_entry, item_subclass, amount) SELECT {}, {}, {}, {}, {} FROM {} WHERE token = {} ON DUPLICATE KEY UPDATE amount = {}",
+                    tables.rows, owner.accountId, owner.guid, write.entry,
+                    write.subclass, write.amount, tables.ops, token,
+                    write.amount);
+  }
+}
+
+void ReagentBankLedger::CommitVersionedAsync(
+    ReagentBankOwner const &owner, uint32 expectedVersion,
+    ReagentBankItemMap const &items,
+    std::vector<ReagentBankItemAmount> const &amounts,
+    std::function<void(bool)> callback)
+{
+  uint64 token = NewToken();
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  AppendVersionedWrite(trans, ReagentBankTables(), m_storage, owner,
+                       expectedVersion, items, amounts, token);
+  uint64 key = owner.GetKey();
+  // Reads meanwhile may or may not see the write, none of them is cached
+  ++m_writesInFlight[key];
+  uint32 queued = getMSTime();
+  m_depositCallbacks.AddCallback(
+      ReagentBankDatabase.AsyncCommitTransaction(trans).AfterComplete(
+          [=, this](bool /*success*/)
+          {
+            sReagentBankDatabasePool->RecordWait(queued);
+            // A commit reported as failed may have landed after all; only
+            // the token tells
+            m_queryCallbacks.AddCallback(
+                ReagentBankDatabase.AsyncQuery("SELECT 1 FROM mod_reagent_bank_account_ops WHERE token = " + std::to_string(token))
+                    .WithCallback(
+                        [=, this](QueryResult result)
+                        {
+                          auto it = m_writesInFlight.find(key);
+                          if (it != m_writesInFlight.end() && !--it->second)
+                            m_writesInFlight.erase(it);
+                          if (result)
+                            ApplyToCache(owner, items, amounts);
+                          callback(result != nullptr);
+                        }));
+          }));
+}
+
+bool ReagentBankLedger::CommitVersioned(
+    ReagentBankOwner const &owner, uint32 expectedVersion,
+    ReagentBankItemMap const &items,
+    std::vector<ReagentBankItemAmount> const &amounts, uint64 token)
+{
+  if (!token)
+    token = NewToken();
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  AppendVersionedWrite(trans, ReagentBankTables(), m_storage, owner,
+                       expectedVersion, items, amounts, token);
+  ReagentBankDatabase.DirectCommitTransaction(trans);
+
+  if (!ReagentBankDatabase.Query("SELECT 1 FROM mod_reagent_bank_account_ops WHERE token = {}", token))
+    return false;
+  ApplyToCache(owner, items, amounts);
+  return true;
+}
+
+void ReagentBankLedger::Unload(ReagentBankOwner const &owner)
+{
+  m_owners.erase(owner.GetKey());
+  m_lastWrite.erase(owner.GetKey());
+}
+
+void ReagentBankLedger::ConvertStorage()
+{
+  if (!m_convert)
+    return;
+  bool toPacked = m_target == REAGENT_BANK_STORAGE_PACKED;
+  LOG_INFO("module", ">> Moving the reagent banks to the {} storage format...",
+           toPacked ? "packed" : "rows");
+  uint32 start = getMSTime();
+  uint32 converted = toPacked ? ConvertToPacked() : ConvertToRows();
+
+  // Other worldservers follow the format stored here, whatever their config
+  ReagentBankDatabase.DirectExecute("REPLACE INTO mod_reagent_bank_account_storage (id, format) VALUES (0, {})",
+                                    uint8(m_target));
+  m_convert = false;
+  m_storage = m_target;
+  LOG_INFO("module", ">> Moved {} reagent banks to the {} storage format in {} ms",
+           converted, toPacked ? "packed" : "rows", GetMSTimeDiffToNow(start));
+}
+
+uint32 ReagentBankLedger::ConvertToPacked()
+{
+  uint32 converted = 0;
+  ReagentBankOwner owner;
+  ReagentBankItemMap items;
+  auto flush = [&](CharacterDatabaseTransaction trans)
+  {
+    if (items.empty())
+      return;
+    trans->Append("INSERT INTO mod_reagent_bank_account_version (account_id, guid, version) VALUES ({}, {}, 1) ON DUPLICATE KEY UPDATE version = version + 1",
+                  owner.accountId, owner.guid);
+    trans->Append("REPLACE INTO mod_reagent_bank_account_packed (account_id, guid, data) VALUES ({}, {}, X'{}')",
+                  owner.accountId, owner.guid,
+                  ByteArrayToHexStr(EncodeReagentBank(items)));
+    trans->Append("DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {}",
+                  owner.accountId, owner.guid);
+    items.clear();
+    ++converted;
+  };
+
+  // Keyset pagination over the primary key; a bank may span two chunks, its
+  // rows are only removed once all of them were read
+  uint32 lastAccount = 0, lastGuid = 0, lastEntry = 0;
+  while (true)
+  {
+    QueryResult result = ReagentBankDatabase.Query(
+        "SELECT account_id, guid, item_entry, item_subclass, amount FROM mod_reagent_bank_account WHERE (account_id, guid, item_entry) > ({}, {}, {}) ORDER BY account_id, guid, item_entry LIMIT {}",
+        lastAccount, lastGuid, lastEntry, CONVERT_CHUNK_ROWS);
+    if (!result)
+      break;
+    auto trans = ReagentBankDatabase.BeginTransaction();
+    do
+    {
+      Field *fields = result->Fetch();
+      lastAccount = fields[0].Get<uint32>();
+      lastGuid = fields[1].Get<uint32>();
+      lastEntry = fields[2].Get<uint32>();
+      if (lastAccount != owner.accountId || lastGuid != owner.guid)
+      {
+        flush(trans);
+        owner.accountId = lastAccount;
+        owner.guid = lastGuid;
+      }
+      items[lastEntry] = {fields[3].Get<uint32>(), fields[4].Get<uint32>()};
+    } while (result->NextRow());
+    ReagentBankDatabase.DirectCommitTransaction(trans);
+  }
+  auto trans = ReagentBankDatabase.BeginTransaction();
+  flush(trans);
+  ReagentBankDatabase.DirectCommitTransaction(trans);
+  return converted;
+}
+
+uint32 ReagentBankLedger::ConvertToRows()
+{
+  uint32 converted = 0;
+  uint32 lastAccount = 0, lastGuid = 0;
+  // Keyset pagination over the primary key, one blob per bank
+  while (QueryResult result = ReagentBankDatabase.Query(
+             "SELECT account_id, guid, data FROM mod_reagent_bank_account_packed WHERE (account_id, guid) > ({}, {}) ORDER BY account_id, guid LIMIT {}",
+             lastAccount, lastGuid, CONVERT_CHUNK_BANKS))
+  {
+    auto trans = ReagentBankDatabase.BeginTransaction();
+    do
+    {
+      Field *fields = result->Fetch();
+      lastAccount = fields[0].Get<uint32>();
+      lastGuid = fields[1].Get<uint32>();
+      ReagentBankItemMap items;
+      if (!DecodeReagentBank(fields[2].Get<Binary>(), items))
+      {
+        // Left where it is for a newer worldserver to read
+        LOG_ERROR("module", "Reagent bank: cannot read the packed bank of account {} guid {}, not moved",
+                  lastAccount, lastGuid);
+        continue;
+      }
+      trans->Append("INSERT INTO mod_reagent_bank_account_version (account_id, guid, version) VALUES ({}, {}, 1) ON DUPLICATE KEY UPDATE version = version + 1",
+                    lastAccount, lastGuid);
+      trans->Append("DELETE FROM mod_reagent_bank_account WHERE account_id = {} AND guid = {}",
+                    lastAccount, lastGuid);
+      std::ostringstream rows;
+      bool first = true;
+      for (auto const &itr : items)
+      {
+        rows << (first ? "(" : ", (") << lastAccount << ", " << lastGuid
+             << ", " << itr.first << ", " << itr.second.subclass << ", "
+             << itr.second.amount << ")";
+        first = false;
+      }
+      if (!items.empty())
+        trans->Append("INSERT INTO mod_reagent_bank_account (account_id, guid, item_entry, item_subclass, amount) VALUES {}",
+                      rows.str());
+      trans->Append("DELETE FROM mod_reagent_bank_account_packed WHERE account_id = {} AND guid = {}",
+                    lastAccount, lastGuid);
+      ++converted;
+    } while (result->NextRow());
+    ReagentBankDatabase.DirectCommitTransaction(trans);
+  }
+  return converted;
+}
+
+void ReagentBankLedger::PruneOperations()
+{
+  time_t cutoff = GameTime::GetGameTime().count() - OPS_RETENTION_SECONDS;
+  // The replay tells by the token whether a journaled deposit landed
+  if (time_t oldest = sReagentBankJournal->GetOldestTime())
+    cutoff = std::min(cutoff, oldest);
+  ReagentBankDatabase.Execute("DELETE FROM mod_reagent_bank_account_ops WHERE time < {}",
+                            cutoff);
+}
@@ -0,0 +1,271 @@
+#ifndef AZEROTHCORE_REAGENTBANKLEDGER_H
+#define AZEROTHCORE_REAGENTBANKLEDGER_H
+#include "AsyncCallbackProcessor.h"
+#include "DatabaseEnv.h"
+#include "Player.h"
+#include "QueryCallback.h"
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#define MAX_WRITE_ATTEMPTS 3
+#define OPS_RETENTION_SECONDS DAY
+#define CONVERT_CHUNK_ROWS 10000
+// Blobs, of up to a few hundred reagents each
+#define CONVERT_CHUNK_BANKS 100
+#define DEPOSIT_RETRY_INTERVAL 5000
+// Version of a bank whose blob cannot be read: never matches the DB, so
+// every versioned write to it fails instead of overwriting the blob
+#define UNREADABLE_VERSION 0xFFFFFFFF
+
+enum ReagentBankStorageFormat : uint8 {
+  // One row per (owner, item_entry) in mod_reagent_bank_account
+  REAGENT_BANK_STORAGE_ROWS = 0,
+  // One blob per owner in mod_reagent_bank_account_packed
+  REAGENT_BANK_STORAGE_PACKED = 1
+};
+
+// Identifies one reagent bank. We store either:
+//  account_id = <acct>, guid = 0   (account-wide mode)
+//  account_id = 0,      guid = <guid> (per-character mode)
+// or, for a guild bank, guild_id = <guild> with guid = the member
+// depositing, see ReagentBankGuild
+struct ReagentBankOwner
+{
+  uint32 accountId = 0;
+  uint32 guid = 0;
+  uint32 guildId = 0;
+
+  // Guild banks get keys of their own, whichever member is depositing
+  uint64 GetKey() const
+  {
+    if (guildId)
+      return (uint64(1) << 63) | guildId;
+    return (uint64(accountId) << 32) | guid;
+  }
+};
+
+struct ReagentBankStoredItem
+{
+  uint32 subclass = 0;
+  uint32 amount = 0;
+};
+
+// A stored amount to write, or an amount to add on deposit
+struct ReagentBankItemAmount
+{
+  uint32 entry;
+  uint32 subclass;
+  uint32 amount;
+};
+
+// item_entry -> stored item
+typedef std::map<uint32, ReagentBankStoredItem> ReagentBankItemMap;
+typedef std::function<void(ReagentBankItemMap const &)> ReagentBankLoadCallback;
+typedef std::function<void(ReagentBankItemMap const &, uint32 version)>
+    ReagentBankReadCallback;
+
+ReagentBankOwner GetReagentBankOwner(Player *player);
+
+// Tables the banks and their versions are kept in; the benchmark runs the
+// ledger's statements on copies of them
+struct ReagentBankTables
+{
+  char const *rows = "mod_reagent_bank_account";
+  char const *packed = "mod_reagent_bank_account_packed";
+  char const *version = "mod_reagent_bank_account_version";
+  char const *ops = "mod_reagent_bank_account_ops";
+};
+
+// In-memory mirror of the banks of online players, so lookups such as the
+// name search never need a DB query, and the only place writing
+// mod_reagent_bank_account.
+//
+// Several worldservers may share one characters DB, so every bank has a
+// version in mod_reagent_bank_account_version that each write bumps:
+//  - deposits only add to amounts, commute and never conflict
+//  - withdraws read the bank and its version from the DB and write their
+//    new amounts only if the version did not move meanwhile. The outcome
+//    is read back through an operation token, a conflict is retried.
+// With the packed storage format a bank is a single blob, so deposits are
+// versioned writes as well, read and written back asynchronously.
+// The cache holds the deposits of this worldserver before they landed. A
+// read from the DB may miss them, so it only replaces the cache while none
+// of this worldserver's writes to the bank are in flight.
+// Only used from the world thread.
+class ReagentBankLedger
+{
+public:
+  static ReagentBankLedger *instance();
+
+  void LoadConfig();
+  // Blocking: also reads the storage format the banks are in
+  void Initialize();
+
+  // Returns nullptr when the bank has not been loaded yet
+  ReagentBankItemMap const *GetItems(ReagentBankOwner const &owner) const;
+  // Invokes the callback once the player's bank is in memory
+  void LoadAsync(Player *player, ReagentBankLoadCallback callback);
+  // Reads the bank and its version from the DB for a withdraw to plan
+  // against, and refreshes the cache with it if allowed
+  void ReadAsync(ReagentBankOwner const &owner,
+                 ReagentBankReadCallback callback);
+  // Blocking: reads the bank from the DB and returns its version, the cache
+  // is left alone
+  uint32 Read(ReagentBankOwner const &owner, ReagentBankItemMap &items);
+
+  // Adds the amounts to the bank. The destroyed items are journaled until
+  // the commit lands; the callback runs once it did.
+  void Deposit(ReagentBankOwner const &owner,
+               std::vector<ReagentBankItemAmount> const &amounts,
+               std::vector<uint32> const &itemGuids,
+               std::function<void()> callback = nullptr);
+  // Commits a journaled deposit again, of a personal or a guild bank, after
+  // its commit failed; every DEPOSIT_RETRY_INTERVAL ms until it landed
+  void RetryDeposit(ReagentBankOwner const &owner,
+                    std::vector<ReagentBankItemAmount> const &amounts,
+                    uint64 token, std::function<void()> callback = nullptr);
+  // Blocking: adds the amounts to the bank under the given operation token,
+  // used to replay the journal
+  bool ApplyDeposit(ReagentBankOwner const &owner,
+                    std::vector<ReagentBankItemAmount> const &amounts,
+                    uint64 token);
+  // Writes the new stored amounts (0 removes the entry) if the bank is
+  // still at expectedVersion, where it held items; the callback gets false
+  // on a conflicting write
+  void CommitVersionedAsync(ReagentBankOwner const &owner,
+                            uint32 expectedVersion,
+                            ReagentBankItemMap const &items,
+                            std::vector<ReagentBankItemAmount> const &amounts,
+                            std::function<void(bool)> callback);
+  // Blocking version of CommitVersionedAsync, used to replay the journal
+  bool CommitVersioned(ReagentBankOwner const &owner, uint32 expectedVersion,
+                       ReagentBankItemMap const &items,
+                       std::vector<ReagentBankItemAmount> const &amounts,
+                       uint64 token = 0);
+
+  // Operation token, unique across worldservers
+  uint64 NewToken();
+
+  ReagentBankStorageFormat GetStorageFormat() const { return m_storage; }
+  // Blocking, on startup after the journal replay and before anyone can
+  // deposit: moves every bank still in the other format's table into the
+  // one the config asks for, either way, and records the switch in the DB.
+  // Each bank is written and removed from the old table in one
+  // transaction, so a conversion cut short resumes on the next startup.
+  // Other worldservers on the same characters DB must be stopped meanwhile.
+  void ConvertStorage();
+
+  // The read and the versioned write of a bank exactly as the ledger runs
+  // them, on the given tables; thread safe
+  static std::string GetLoadQuery(ReagentBankTables const &tables,
+                                  ReagentBankStorageFormat storage,
+                                  ReagentBankOwner const &owner);
+  // Returns the version read, UNREADABLE_VERSION for a blob that cannot be
+  // decoded
+  static uint32 ReadBank(ReagentBankStorageFormat storage, QueryResult result,
+                         ReagentBankItemMap &items);
+  static void
+  AppendVersionedWrite(CharacterDatabaseTransaction trans,
+                       ReagentBankTables const &tables,
+                       ReagentBankStorageFormat storage,
+                       ReagentBankOwner const &owner, uint32 expectedVersion,
+                       ReagentBankItemMap const &items,
+                       std::vector<ReagentBankItemAmount> const &amounts,
+                       uint64 token);
+
+  void Unload(ReagentBankOwner const &owner);
+  // Forgets old operation tokens, except those the journal still needs
+  void PruneOperations();
+  // Runs the callbacks of landed deposits and retries the failed ones
+  void Update(uint32 diff);
+
+private:
+  // A bank as read from the DB
+  struct OwnerState
+  {
+    ReagentBankItemMap items;
+    uint32 version = 0;
+  };
+
+  struct QueuedDeposit
+  {
+    ReagentBankOwner owner;
+    std::vector<ReagentBankItemAmount> amounts;
+    uint64 token = 0;
+    std::function<void()> callback;
+    // Conflicting packed writes in a row
+    uint32 attempts = 0;
+  };
+
+  std::string GetLoadQuery(ReagentBankOwner const &owner) const;
+  void Fill(OwnerState &state, QueryResult result) const;
+  void AppendDeposit(CharacterDatabaseTransaction trans,
+                     ReagentBankOwner const &owner,
+                     std::vector<ReagentBankItemAmount> const &amounts,
+                     uint64 token);
+  // Adds the amounts to the cached bank, if loaded
+  void AddToCache(ReagentBankOwner const &owner,
+                  std::vector<ReagentBankItemAmount> const &amounts);
+  // Applies a versioned write to the cached bank, if loaded, as the change
+  // from items, the bank it was planned against; deposits still in flight
+  // stay on top
+  void ApplyToCache(ReagentBankOwner const &owner,
+                    ReagentBankItemMap const &items,
+                    std::vector<ReagentBankItemAmount> const &amounts);
+  // Whether a read issued at write serial issued may replace the cache
+  bool CanCache(uint64 key, uint64 issued) const;
+  void CommitDeposit(QueuedDeposit const &deposit);
+  void CommitPackedDeposit(QueuedDeposit const &deposit);
+  // Reads the token back, the versioned write may have found another version
+  void ConfirmPackedDeposit(QueuedDeposit const &deposit);
+  void Landed(QueuedDeposit const &deposit);
+  void QueueRetry(QueuedDeposit const &deposit);
+  // The version check and operation token of a versioned write
+  static void AppendVersionBump(CharacterDatabaseTransaction trans,
+                                ReagentBankTables const &tables,
+                                ReagentBankOwner const &owner,
+                                uint32 expectedVersion, uint64 token);
+  // Writes the blob if the version check passed
+  static void AppendPackedData(CharacterDatabaseTransaction trans,
+                               ReagentBankTables const &tables,
+                               ReagentBankOwner const &owner,
+                               ReagentBankItemMap const &items, uint64 token);
+  // The passes of ConvertStorage, returning how many banks they moved
+  uint32 ConvertToPacked();
+  uint32 ConvertToRows();
+  // Reads and adds the amounts with versioned writes
+  bool DepositVersioned(ReagentBankOwner const &owner,
+                        std::vector<ReagentBankItemAmount> const &amounts,
+                        uint64 token);
+
+  ReagentBankStorageFormat m_storage = REAGENT_BANK_STORAGE_ROWS;
+  // The format of the config, which ConvertStorage moves the banks to
+  ReagentBankStorageFormat m_target = REAGENT_BANK_STORAGE_ROWS;
+  bool m_convert = false;
+
+  std::unordered_map<uint64, ReagentBankItemMap> m_owners;
+  // Counts this worldserver's writes; owner key -> serial of its last write
+  // to the bank, a read issued before then may miss it
+  uint64 m_writeSerial = 0;
+  std::unordered_map<uint64, uint64> m_lastWrite;
+
+  AsyncCallbackProcessor<TransactionCallback> m_depositCallbacks;
+  QueryCallbackProcessor m_queryCallbacks;
+  std::vector<QueuedDeposit> m_retries;
+  // owner key -> personal deposits not landed yet
+  std::unordered_map<uint64, uint32> m_inFlight;
+  // owner key -> versioned writes not read back yet
+  std::unordered_map<uint64, uint32> m_writesInFlight;
+  uint32 m_retryTimer = 0;
+
+  // High half: random per process, low half: counter
+  uint64 m_tokenBase = 0;
+  uint32 m_tokenCounter = 0;
+};
+
+#define sReagentBankLedger ReagentBankLedger::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKLEDGER_H
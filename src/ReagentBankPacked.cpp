@@ -0,0 +1,72 @@
+#include "ReagentBankPacked.h"
+
+static void WriteVarInt(std::vector<uint8> &data, uint32 value)
+{
+  while (value >= 0x80)
+  {
+    data.push_back(uint8(value) | 0x80);
+    value >>= 7;
+  }
+  data.push_back(uint8(value));
+}
+
+static bool ReadVarInt(std::vector<uint8> const &data, size_t &pos,
+                       uint32 &value)
+{
+  value = 0;
+  for (uint32 shift = 0; shift <= 28; shift += 7)
+  {
+    if (pos >= data.size())
+      return false;
+    uint8 byte = data[pos++];
+    // The fifth byte holds the top 4 bits and ends the value
+    if (shift == 28 && byte > 0x0F)
+      return false;
+    value |= uint32(byte & 0x7F) << shift;
+    if (!(byte & 0x80))
+      return true;
+  }
+  return false;
+}
+
+std::vector<uint8> EncodeReagentBank(ReagentBankItemMap const &items)
+{
+  std::vector<uint8> data;
+  // Most reagents fit in 2 + 1 + 2 bytes
+  data.reserve(2 + items.size() * 5);
+  data.push_back(PACKED_FORMAT_VERSION);
+  WriteVarInt(data, items.size());
+  uint32 previousEntry = 0;
+  for (auto const &itr : items)
+  {
+    WriteVarInt(data, itr.first - previousEntry);
+    WriteVarInt(data, itr.second.subclass);
+    WriteVarInt(data, itr.second.amount);
+    previousEntry = itr.first;
+  }
+  return data;
+}
+
+bool DecodeReagentBank(std::vector<uint8> const &data, ReagentBankItemMap &items)
+{
+  items.clear();
+  if (data.empty() || data[0] != PACKED_FORMAT_VERSION)
+    return false;
+  size_t pos = 1;
+  uint32 count = 0;
+  if (!ReadVarInt(data, pos, count))
+    return false;
+  uint32 entry = 0;
+  for (uint32 i = 0; i < count; ++i)
+  {
+    uint32 delta = 0;
+    ReagentBankStoredItem item;
+    if (!ReadVarInt(data, pos, delta) || !ReadVarInt(data, pos, item.subclass) ||
+        !ReadVarInt(data, pos, item.amount))
+      return false;
+    entry += delta;
+    // Sorted input, so this appends
+    items.emplace_hint(items.end(), entry, item);
+  }
+  return pos == data.size();
+}
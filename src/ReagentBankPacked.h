@@ -0,0 +1,16 @@
+#ifndef AZEROTHCORE_REAGENTBANKPACKED_H
+#define AZEROTHCORE_REAGENTBANKPACKED_H
+#include "ReagentBankLedger.h"
+#include <vector>
+
+#define PACKED_FORMAT_VERSION 1
+
+// Binary format of mod_reagent_bank_account_packed.data, one blob per bank:
+//  <format version byte> <varint count>
+//  count x <varint entry delta> <varint subclass> <varint amount>
+// Entries are sorted, each one stored as the distance to the previous one.
+std::vector<uint8> EncodeReagentBank(ReagentBankItemMap const &items);
+// False for unknown format versions and truncated data
+bool DecodeReagentBank(std::vector<uint8> const &data, ReagentBankItemMap &items);
+
+#endif // AZEROTHCORE_REAGENTBANKPACKED_H
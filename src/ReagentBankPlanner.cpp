@@ -0,0 +1,90 @@
+#include "ReagentBankPlanner.h"
+#include "Bag.h"
+
+ReagentBankBagPlanner::ReagentBankBagPlanner(Player *player)
+{
+  uint32 freeGeneralSlots = 0;
+  std::unordered_map<uint32, uint32> freeSpecialSlots;
+
+  auto addItem = [this](Item *pItem)
+  {
+    uint32 stackSize = pItem->GetTemplate()->GetMaxStackSize();
+    if (pItem->GetCount() < stackSize)
+      m_stackRoom[pItem->GetEntry()] += stackSize - pItem->GetCount();
+  };
+
+  // Inventory Items
+  for (uint8 i = INVENTORY_SLOT_ITEM_START; i < INVENTORY_SLOT_ITEM_END; ++i)
+  {
+    if (Item *pItem = player->GetItemByPos(INVENTORY_SLOT_BAG_0, i))
+      addItem(pItem);
+    else
+      ++freeGeneralSlots;
+  }
+  // Bag Items
+  for (uint32 i = INVENTORY_SLOT_BAG_START; i < INVENTORY_SLOT_BAG_END; i++)
+  {
+    Bag *bag = player->GetBagByPos(i);
+    if (!bag)
+      continue;
+    uint32 bagFamily = bag->GetTemplate()->BagFamily;
+    for (uint32 j = 0; j < bag->GetBagSize(); j++)
+    {
+      if (Item *pItem = player->GetItemByPos(i, j))
+        addItem(pItem);
+      else if (bagFamily)
+        ++freeSpecialSlots[bagFamily];
+      else
+        ++freeGeneralSlots;
+    }
+  }
+
+  for (auto const &itr : freeSpecialSlots)
+    m_freeSlots.push_back({itr.first, itr.second});
+  m_freeSlots.push_back({0, freeGeneralSlots});
+}
+
+ReagentBankBagPlanner::ReagentBankBagPlanner(
+    uint32 freeSlots, std::unordered_map<uint32, uint32> const &stackRoom)
+    : m_stackRoom(stackRoom)
+{
+  m_freeSlots.push_back({0, freeSlots});
+}
+
+uint32 ReagentBankBagPlanner::FillSlots(uint32 &freeSlots, uint32 entry,
+                                        uint32 stackSize, uint32 count)
+{
+  uint32 slotsNeeded = (count + stackSize - 1) / stackSize;
+  uint32 slotsUsed = std::min(slotsNeeded, freeSlots);
+  freeSlots -= slotsUsed;
+  uint32 fit = std::min(count, slotsUsed * stackSize);
+  // The last new stack may have room left for later reservations
+  if (slotsUsed * stackSize > fit)
+    m_stackRoom[entry] += slotsUsed * stackSize - fit;
+  return fit;
+}
+
+uint32 ReagentBankBagPlanner::Reserve(ItemTemplate const *itemTemplate,
+                                      uint32 count)
+{
+  uint32 entry = itemTemplate->ItemId;
+  uint32 stackSize = itemTemplate->GetMaxStackSize();
+  uint32 fit = 0;
+
+  auto room = m_stackRoom.find(entry);
+  if (room != m_stackRoom.end())
+  {
+    fit = std::min(count, room->second);
+    room->second -= fit;
+  }
+
+  for (FreeSlots &slots : m_freeSlots)
+  {
+    if (fit == count)
+      break;
+    if (slots.bagFamily && !(slots.bagFamily & itemTemplate->BagFamily))
+      continue;
+    fit += FillSlots(slots.count, entry, stackSize, count - fit);
+  }
+  return fit;
+}
@@ -0,0 +1,40 @@
+#ifndef AZEROTHCORE_REAGENTBANKPLANNER_H
+#define AZEROTHCORE_REAGENTBANKPLANNER_H
+#include "ItemTemplate.h"
+#include "Player.h"
+#include <unordered_map>
+#include <vector>
+
+// Bag space of a player gathered in a single pass over the inventory, so a
+// multi-stack withdraw can decide up front how much of each entry fits
+// instead of asking Player::CanStoreNewItem once per stack.
+class ReagentBankBagPlanner
+{
+public:
+  explicit ReagentBankBagPlanner(Player *player);
+  // Bags that are not a player's: their empty general slots, and the room
+  // left on top of their existing stacks per item entry
+  ReagentBankBagPlanner(uint32 freeSlots,
+                        std::unordered_map<uint32, uint32> const &stackRoom);
+
+  // Reserves room for up to count items of the template and returns how
+  // many of them fit into the space that is still unreserved
+  uint32 Reserve(ItemTemplate const *itemTemplate, uint32 count);
+
+private:
+  struct FreeSlots
+  {
+    uint32 bagFamily;
+    uint32 count;
+  };
+
+  uint32 FillSlots(uint32 &freeSlots, uint32 entry, uint32 stackSize,
+                   uint32 count);
+
+  // Empty slots of specialized bags first, like the core stores them
+  std::vector<FreeSlots> m_freeSlots;
+  // item entry -> room left on top of existing, not full stacks
+  std::unordered_map<uint32, uint32> m_stackRoom;
+};
+
+#endif // AZEROTHCORE_REAGENTBANKPLANNER_H
@@ -0,0 +1,167 @@
+#include "ReagentBankSearch.h"
+#include "ObjectMgr.h"
+#include "ReagentBankAccount.h"
+#include "Timer.h"
+#include "Util.h"
+#include <algorithm>
+
+ReagentBankSearchIndex *ReagentBankSearchIndex::instance()
+{
+  static ReagentBankSearchIndex instance;
+  return &instance;
+}
+
+uint64 ReagentBankSearchIndex::MakeTrigram(wchar_t a, wchar_t b, wchar_t c)
+{
+  return (uint64(a) << 42) | (uint64(b) << 21) | uint64(c);
+}
+
+void ReagentBankSearchIndex::Build()
+{
+  uint32 oldMSTime = getMSTime();
+  m_trigrams.clear();
+  m_words.clear();
+  m_names.clear();
+
+  for (auto const &itr : *sObjectMgr->GetItemTemplateStore())
+  {
+    ItemTemplate const *itemTemplate = &itr.second;
+    if (!IsReagentBankItem(itemTemplate))
+      continue;
+    AddName(itemTemplate->ItemId, itemTemplate->Name1);
+    if (ItemLocale const *il = sObjectMgr->GetItemLocale(itemTemplate->ItemId))
+      for (std::string const &name : il->Name)
+        if (!name.empty())
+          AddName(itemTemplate->ItemId, name);
+  }
+
+  // The template store is unordered, posting lists must be sorted to be
+  // intersected
+  for (auto &itr : m_trigrams)
+  {
+    std::sort(itr.second.begin(), itr.second.end());
+    itr.second.erase(std::unique(itr.second.begin(), itr.second.end()),
+                     itr.second.end());
+  }
+  std::sort(m_words.begin(), m_words.end());
+  m_built = true;
+
+  LOG_INFO("module", ">> Loaded reagent bank search index for {} items in {} ms",
+           m_names.size(), GetMSTimeDiffToNow(oldMSTime));
+}
+
+void ReagentBankSearchIndex::AddName(uint32 entry, std::string const &name)
+{
+  std::wstring wname;
+  if (!Utf8toWStr(name, wname))
+    return;
+  wstrToLower(wname);
+
+  std::vector<std::wstring> &names = m_names[entry];
+  if (std::find(names.begin(), names.end(), wname) != names.end())
+    return;
+  names.push_back(wname);
+
+  for (size_t i = 0; i + 2 < wname.size(); ++i)
+    m_trigrams[MakeTrigram(wname[i], wname[i + 1], wname[i + 2])].push_back(
+        entry);
+
+  size_t start = 0;
+  while (start < wname.size())
+  {
+    size_t end = wname.find(L' ', start);
+    if (end == std::wstring::npos)
+      end = wname.size();
+    if (end > start)
+      m_words.emplace_back(wname.substr(start, end - start), entry);
+    start = end + 1;
+  }
+}
+
+std::vector<uint32> ReagentBankSearchIndex::Find(std::string const &text) const
+{
+  std::vector<uint32> result;
+  std::wstring wtext;
+  if (!m_built || !Utf8toWStr(text, wtext) || wtext.empty())
+    return result;
+  wstrToLower(wtext);
+
+  if (wtext.size() < 3)
+  {
+    auto it = std::lower_bound(m_words.begin(), m_words.end(),
+                               std::make_pair(wtext, uint32(0)));
+    for (; it != m_words.end() &&
+           it->first.compare(0, wtext.size(), wtext) == 0;
+         ++it)
+      result.push_back(it->second);
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+  }
+
+  std::vector<std::vector<uint32> const *> lists;
+  for (size_t i = 0; i + 2 < wtext.size(); ++i)
+  {
+    auto it = m_trigrams.find(MakeTrigram(wtext[i], wtext[i + 1], wtext[i + 2]));
+    if (it == m_trigrams.end())
+      return result;
+    lists.push_back(&it->second);
+  }
+  // Start from the rarest trigram to keep the intersections small
+  std::sort(lists.begin(), lists.end(),
+            [](std::vector<uint32> const *a, std::vector<uint32> const *b)
+            { return a->size() < b->size(); });
+  result = *lists.front();
+  for (size_t i = 1; i < lists.size() && !result.empty(); ++i)
+  {
+    std::vector<uint32> merged;
+    std::set_intersection(result.begin(), result.end(), lists[i]->begin(),
+                          lists[i]->end(), std::back_inserter(merged));
+    result.swap(merged);
+  }
+
+  // Trigrams may match out of order, keep only real substring matches
+  result.erase(std::remove_if(result.begin(), result.end(),
+                              [&](uint32 entry)
+                              {
+                                std::vector<std::wstring> const &names =
+                                    m_names.at(entry);
+                                return std::none_of(
+                                    names.begin(), names.end(),
+                                    [&](std::wstring const &name)
+                                    { return name.find(wtext) != std::wstring::npos; });
+                              }),
+               result.end());
+  return result;
+}
+
+std::vector<std::pair<uint32, uint32>>
+ReagentBankSearchIndex::FindStored(ReagentBankItemMap const &items,
+                                   std::string const &text, uint32 limit) const
+{
+  std::vector<std::pair<uint32, uint32>> stored;
+  std::vector<uint32> matches = Find(text);
+  // Walk whichever side is smaller; both are ordered by entry
+  if (items.size() < matches.size())
+  {
+    for (auto const &itr : items)
+    {
+      if (stored.size() >= limit)
+        break;
+      if (std::binary_search(matches.begin(), matches.end(), itr.first))
+        stored.emplace_back(itr.first, itr.second.amount);
+    }
+  }
+  else
+  {
+    for (uint32 entry : matches)
+    {
+      if (stored.size() >= limit)
+        break;
+      auto it = items.find(entry);
+      if (it != items.end())
+        stored.emplace_back(entry, it->second.amount);
+    }
+  }
+  return stored;
+}
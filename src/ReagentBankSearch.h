@@ -0,0 +1,39 @@
+#ifndef AZEROTHCORE_REAGENTBANKSEARCH_H
+#define AZEROTHCORE_REAGENTBANKSEARCH_H
+#include "ReagentBankLedger.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Name index over every item the bank accepts, in all loaded locales.
+// Queries of three or more characters intersect trigram posting lists,
+// shorter ones do a prefix lookup over the sorted words of each name.
+class ReagentBankSearchIndex
+{
+public:
+  static ReagentBankSearchIndex *instance();
+
+  void Build();
+  // Sorted item entries whose name contains the text
+  std::vector<uint32> Find(std::string const &text) const;
+  // Stored items of one bank whose name contains the text, by entry
+  std::vector<std::pair<uint32, uint32>>
+  FindStored(ReagentBankItemMap const &items, std::string const &text,
+             uint32 limit) const;
+
+private:
+  static uint64 MakeTrigram(wchar_t a, wchar_t b, wchar_t c);
+  void AddName(uint32 entry, std::string const &name);
+
+  bool m_built = false;
+  // trigram -> sorted item entries
+  std::unordered_map<uint64, std::vector<uint32>> m_trigrams;
+  // (lowercase word, item entry), sorted
+  std::vector<std::pair<std::wstring, uint32>> m_words;
+  // item entry -> lowercase names
+  std::unordered_map<uint32, std::vector<std::wstring>> m_names;
+};
+
+#define sReagentBankSearchIndex ReagentBankSearchIndex::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKSEARCH_H
@@ -0,0 +1,109 @@
+#include "ReagentBankThrottle.h"
+#include "Config.h"
+#include "Log.h"
+#include "Timer.h"
+
+ReagentBankThrottle *ReagentBankThrottle::instance()
+{
+  static ReagentBankThrottle instance;
+  return &instance;
+}
+
+void ReagentBankThrottle::LoadConfig()
+{
+  m_enabled =
+      sConfigMgr->GetOption<bool>("ReagentBankAccount.Throttle.Enable", true);
+  m_burst = float(sConfigMgr->GetOption<uint32>(
+      "ReagentBankAccount.Throttle.Burst", 10));
+  m_perSecond = float(sConfigMgr->GetOption<uint32>(
+      "ReagentBankAccount.Throttle.PerSecond", 4));
+}
+
+bool ReagentBankThrottle::Allow(uint32 guidLow)
+{
+  if (!m_enabled)
+    return true;
+
+  PlayerState &state = m_players[guidLow];
+  uint32 now = getMSTime();
+  if (!state.initialized)
+  {
+    state.tokens = m_burst;
+    state.initialized = true;
+  }
+  else
+  {
+    state.tokens = std::min(m_burst, state.tokens +
+                                         getMSTimeDiff(state.lastRefill, now) *
+                                             m_perSecond / 1000.0f);
+  }
+  state.lastRefill = now;
+
+  if (state.tokens < 1.0f)
+  {
+    ++m_throttled;
+    LOG_DEBUG("module", "Reagent bank: throttled action of player {}", guidLow);
+    return false;
+  }
+  state.tokens -= 1.0f;
+  return true;
+}
+
+bool ReagentBankThrottle::BeginDeposit(uint32 guidLow)
+{
+  PlayerState &state = m_players[guidLow];
+  uint32 now = getMSTime();
+  if (state.depositInFlight)
+  {
+    if (getMSTimeDiff(state.depositStart, now) < DEPOSIT_IN_FLIGHT_TIMEOUT)
+    {
+      state.depositPending = true;
+      ++m_coalesced;
+      return false;
+    }
+    // Its late landing clears the flag of this one, which only lets one
+    // more deposit through uncoalesced
+    LOG_DEBUG("module", "Reagent bank: deposit of player {} still in flight after {} ms",
+              guidLow, DEPOSIT_IN_FLIGHT_TIMEOUT);
+  }
+  state.depositInFlight = true;
+  state.depositPending = false;
+  state.depositStart = now;
+  return true;
+}
+
+bool ReagentBankThrottle::EndDeposit(uint32 guidLow)
+{
+  // The player logged out while the deposit was in flight
+  auto it = m_players.find(guidLow);
+  if (it == m_players.end())
+    return false;
+  bool pending = it->second.depositPending;
+  it->second.depositInFlight = false;
+  it->second.depositPending = false;
+  return pending;
+}
+
+uint32 ReagentBankThrottle::BeginRender(uint32 guidLow)
+{
+  // Only called from the gossip handlers, so the player is in the world
+  auto it = m_players.find(guidLow);
+  if (it == m_players.end())
+    it = m_players.emplace(guidLow, PlayerState()).first;
+  return ++it->second.renderGeneration;
+}
+
+bool ReagentBankThrottle::IsLatestRender(uint32 guidLow, uint32 generation)
+{
+  // Nothing to render for a player that logged out meanwhile
+  auto it = m_players.find(guidLow);
+  if (it != m_players.end() && it->second.renderGeneration == generation)
+    return true;
+  ++m_superseded;
+  return false;
+}
+
+void ReagentBankThrottle::RemovePlayer(uint32 guidLow)
+{
+  m_players.erase(guidLow);
+}
@@ -0,0 +1,68 @@
+#ifndef AZEROTHCORE_REAGENTBANKTHROTTLE_H
+#define AZEROTHCORE_REAGENTBANKTHROTTLE_H
+#include "Define.h"
+#include <unordered_map>
+
+// A deposit still not landed after this long no longer holds back the
+// player's next one: its commit failed and waits for a retry, which may
+// take as long as the DB is down
+#define DEPOSIT_IN_FLIGHT_TIMEOUT 30000
+
+// Per-player protection of the DB against clients spamming the banker:
+// a token bucket for every gossip action, coalescing of repeated deposits
+// and dropping of page renders superseded by a newer one. Only used from
+// the world thread.
+class ReagentBankThrottle
+{
+public:
+  static ReagentBankThrottle *instance();
+
+  void LoadConfig();
+
+  // Takes one token from the player's bucket, false when it is empty
+  bool Allow(uint32 guidLow);
+
+  // False when a deposit is already in flight; it is then merged into the
+  // running one, which is repeated once on completion. One in flight for
+  // longer than DEPOSIT_IN_FLIGHT_TIMEOUT is given up on.
+  bool BeginDeposit(uint32 guidLow);
+  // Returns true when deposits were merged meanwhile and one more pass
+  // should be made
+  bool EndDeposit(uint32 guidLow);
+
+  // Every render gets a new generation, only the latest one is shown
+  uint32 BeginRender(uint32 guidLow);
+  bool IsLatestRender(uint32 guidLow, uint32 generation);
+
+  void RemovePlayer(uint32 guidLow);
+
+  uint64 GetThrottledCount() const { return m_throttled; }
+  uint64 GetCoalescedCount() const { return m_coalesced; }
+  uint64 GetSupersededCount() const { return m_superseded; }
+
+private:
+  struct PlayerState
+  {
+    float tokens = 0.0f;
+    uint32 lastRefill = 0;
+    bool initialized = false;
+    bool depositInFlight = false;
+    bool depositPending = false;
+    uint32 depositStart = 0;
+    uint32 renderGeneration = 0;
+  };
+
+  bool m_enabled = true;
+  float m_burst = 10.0f;
+  float m_perSecond = 4.0f;
+
+  std::unordered_map<uint32, PlayerState> m_players;
+
+  uint64 m_throttled = 0;
+  uint64 m_coalesced = 0;
+  uint64 m_superseded = 0;
+};
+
+#define sReagentBankThrottle ReagentBankThrottle::instance()
+
+#endif // AZEROTHCORE_REAGENTBANKTHROTTLE_H
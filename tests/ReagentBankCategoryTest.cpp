@@ -0,0 +1,104 @@
+#include "DatabaseEnv.h"
+#include "ReagentBankCategory.h"
+#include "ReagentBankTest.h"
+
+static ItemTemplate MakeTemplate(uint32 itemClass, uint32 subclass)
+{
+  ItemTemplate itemTemplate;
+  itemTemplate.Class = itemClass;
+  itemTemplate.SubClass = subclass;
+  return itemTemplate;
+}
+
+static uint32 GetCategory(uint32 itemClass, uint32 subclass)
+{
+  ItemTemplate itemTemplate = MakeTemplate(itemClass, subclass);
+  return sReagentBankCategories->GetCategory(&itemTemplate);
+}
+
+REAGENT_BANK_TEST(Category, Defaults)
+{
+  WorldDatabase.Clear();
+  sReagentBankCategories->Load();
+
+  std::vector<ReagentBankCategory> const &categories =
+      sReagentBankCategories->GetAll();
+  CHECK_EQUAL(categories.size(),
+              std::size(DEFAULT_REAGENT_BANK_CATEGORIES) + 1);
+  CHECK_EQUAL(categories.front().id, uint32(ITEM_SUBCLASS_CLOTH));
+  CHECK_EQUAL(categories.back().id, uint32(UNCATEGORIZED_REAGENT_BANK_CATEGORY));
+  for (ReagentBankCategory const &category : categories)
+    CHECK(sReagentBankCategories->GetById(category.id) == &category);
+
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_CLOTH),
+              uint32(ITEM_SUBCLASS_CLOTH));
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_TRADE_GOODS),
+              uint32(ITEM_SUBCLASS_TRADE_GOODS_OTHER));
+  for (uint32 gem = ITEM_SUBCLASS_GEM_RED; gem <= ITEM_SUBCLASS_GEM_PRISMATIC; ++gem)
+    CHECK_EQUAL(GetCategory(ITEM_CLASS_GEM, gem),
+                uint32(ITEM_SUBCLASS_JEWELCRAFTING));
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_WEAPON, 0),
+              uint32(NO_REAGENT_BANK_CATEGORY));
+  // Out of the range of the table
+  CHECK_EQUAL(GetCategory(MAX_ITEM_CLASS, 0), uint32(NO_REAGENT_BANK_CATEGORY));
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, MAX_REAGENT_BANK_ITEM_SUBCLASSES),
+              uint32(NO_REAGENT_BANK_CATEGORY));
+
+  CHECK(!sReagentBankCategories->IsCategory(NO_REAGENT_BANK_CATEGORY));
+  CHECK(sReagentBankCategories->GetById(MAX_REAGENT_BANK_CATEGORIES) == nullptr);
+}
+
+REAGENT_BANK_TEST(Category, FromWorldTables)
+{
+  WorldDatabase.Clear();
+  WorldDatabase.SetTable("mod_reagent_bank_account_category",
+                         {{"20", "Herbs & Cloth", "765", "2"},
+                          {"21", "Gems", "1206", "1"},
+                          // Invalid ids, and one used twice
+                          {"0", "None", "1", "0"},
+                          {"63", "Uncategorized", "1", "0"},
+                          {"64", "Too large", "1", "0"},
+                          {"21", "Gems again", "1206", "0"}});
+  WorldDatabase.SetTable("mod_reagent_bank_account_category_item_class",
+                         {{"7", "9", "20"},
+                          {"7", "5", "20"},
+                          {"3", "0", "21"},
+                          // Unknown category, and out of range classes
+                          {"7", "7", "22"},
+                          {"17", "0", "20"},
+                          {"7", "32", "20"}});
+  sReagentBankCategories->Load();
+
+  std::vector<ReagentBankCategory> const &categories =
+      sReagentBankCategories->GetAll();
+  CHECK_EQUAL(categories.size(), size_t(3));
+  // By sort order, the first of the duplicates kept
+  CHECK_EQUAL(categories[0].id, 21u);
+  CHECK(categories[0].name == "Gems");
+  CHECK_EQUAL(categories[1].id, 20u);
+  CHECK_EQUAL(categories[1].iconItem, 765u);
+  CHECK_EQUAL(categories[2].id, uint32(UNCATEGORIZED_REAGENT_BANK_CATEGORY));
+  CHECK(sReagentBankCategories->GetById(21) == &categories[0]);
+  CHECK(!sReagentBankCategories->IsCategory(ITEM_SUBCLASS_CLOTH));
+
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_HERB), 20u);
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_CLOTH), 20u);
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_RED), 21u);
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_BLUE),
+              uint32(NO_REAGENT_BANK_CATEGORY));
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_METAL_STONE),
+              uint32(NO_REAGENT_BANK_CATEGORY));
+
+  // Only the item classes table filled: the default categories
+  WorldDatabase.SetTable("mod_reagent_bank_account_category", {});
+  WorldDatabase.SetTable("mod_reagent_bank_account_category_item_class",
+                         {{"7", "9", "5"}});
+  sReagentBankCategories->Load();
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_HERB),
+              uint32(ITEM_SUBCLASS_CLOTH));
+  CHECK_EQUAL(GetCategory(ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_CLOTH),
+              uint32(NO_REAGENT_BANK_CATEGORY));
+
+  WorldDatabase.Clear();
+  sReagentBankCategories->Load();
+}
@@ -0,0 +1,92 @@
+#include "ReagentBankPacked.h"
+#include "ReagentBankTest.h"
+#include <random>
+
+static ReagentBankItemMap RandomBank(std::mt19937 &random, uint32 size)
+{
+  ReagentBankItemMap items;
+  std::uniform_int_distribution<uint32> entry(1, 60000);
+  std::uniform_int_distribution<uint32> subclass(0, 63);
+  // Mostly small amounts, now and then one using all 32 bits
+  std::uniform_int_distribution<uint32> amount(1, 1000);
+  std::uniform_int_distribution<uint32> any;
+  while (items.size() < size)
+    items[entry(random)] = {subclass(random),
+                            random() % 16 ? amount(random) : any(random)};
+  return items;
+}
+
+REAGENT_BANK_TEST(Packed, RoundTrip)
+{
+  std::mt19937 random(1);
+  for (uint32 size : {0u, 1u, 2u, 10u, 300u, 5000u})
+  {
+    ReagentBankItemMap items = RandomBank(random, size);
+    std::vector<uint8> data = EncodeReagentBank(items);
+    ReagentBankItemMap decoded;
+    CHECK(DecodeReagentBank(data, decoded));
+    CHECK_EQUAL(decoded.size(), items.size());
+    bool same = decoded.size() == items.size();
+    for (auto const &itr : items)
+    {
+      auto found = decoded.find(itr.first);
+      same = same && found != decoded.end() &&
+             found->second.subclass == itr.second.subclass &&
+             found->second.amount == itr.second.amount;
+    }
+    CHECK(same);
+  }
+}
+
+REAGENT_BANK_TEST(Packed, EmptyBankIsTwoBytes)
+{
+  std::vector<uint8> data = EncodeReagentBank(ReagentBankItemMap());
+  CHECK_EQUAL(data.size(), size_t(2));
+  CHECK_EQUAL(data[0], uint8(PACKED_FORMAT_VERSION));
+}
+
+REAGENT_BANK_TEST(Packed, LargestValues)
+{
+  ReagentBankItemMap items;
+  items[0xFFFFFFFF] = {0xFFFFFFFF, 0xFFFFFFFF};
+  ReagentBankItemMap decoded;
+  CHECK(DecodeReagentBank(EncodeReagentBank(items), decoded));
+  CHECK_EQUAL(decoded[0xFFFFFFFF].subclass, 0xFFFFFFFFu);
+  CHECK_EQUAL(decoded[0xFFFFFFFF].amount, 0xFFFFFFFFu);
+}
+
+REAGENT_BANK_TEST(Packed, RejectsTruncatedAndTrailingData)
+{
+  std::mt19937 random(2);
+  std::vector<uint8> data = EncodeReagentBank(RandomBank(random, 20));
+  ReagentBankItemMap decoded;
+  for (size_t size = 0; size < data.size(); ++size)
+    CHECK(!DecodeReagentBank(std::vector<uint8>(data.begin(), data.begin() + size),
+                             decoded));
+  data.push_back(0);
+  CHECK(!DecodeReagentBank(data, decoded));
+}
+
+REAGENT_BANK_TEST(Packed, RejectsUnknownVersion)
+{
+  std::vector<uint8> data = EncodeReagentBank(ReagentBankItemMap());
+  data[0] = PACKED_FORMAT_VERSION + 1;
+  ReagentBankItemMap decoded;
+  CHECK(!DecodeReagentBank(data, decoded));
+}
+
+REAGENT_BANK_TEST(Packed, RejectsOverlongVarInt)
+{
+  ReagentBankItemMap decoded;
+  // One entry whose amount is 0xFFFFFFFF, in five bytes
+  std::vector<uint8> data = {PACKED_FORMAT_VERSION, 1, 1, 0,
+                             0xFF, 0xFF, 0xFF, 0xFF, 0x0F};
+  CHECK(DecodeReagentBank(data, decoded));
+  // A fifth byte with more than the top 4 bits
+  data[8] = 0x10;
+  CHECK(!DecodeReagentBank(data, decoded));
+  // A fifth byte asking for a sixth
+  data[8] = 0x8F;
+  data.push_back(0);
+  CHECK(!DecodeReagentBank(data, decoded));
+}
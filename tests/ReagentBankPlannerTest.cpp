@@ -0,0 +1,314 @@
+#include "DatabaseEnv.h"
+#include "ReagentBankCategory.h"
+#include "ReagentBankEngine.h"
+#include "ReagentBankPacked.h"
+#include "ReagentBankTest.h"
+#include <functional>
+#include <random>
+
+#define BAG_FAMILY_MASK_HERBS 0x00000020
+#define BAG_FAMILY_MASK_ENCHANTING_SUPP 0x00000040
+#define BAG_FAMILY_MASK_MINING_SUPP 0x00000200
+
+static ItemTemplate MakeItem(uint32 entry, uint32 itemClass, uint32 subclass,
+                             int32 stackable, uint32 bagFamily = 0)
+{
+  ItemTemplate itemTemplate;
+  itemTemplate.ItemId = entry;
+  itemTemplate.Class = itemClass;
+  itemTemplate.SubClass = subclass;
+  itemTemplate.Stackable = stackable;
+  itemTemplate.BagFamily = bagFamily;
+  return itemTemplate;
+}
+
+static ItemTemplate MakeBag(uint32 entry, uint32 slots, uint32 bagFamily)
+{
+  ItemTemplate itemTemplate =
+      MakeItem(entry, ITEM_CLASS_CONTAINER, 0, 1);
+  itemTemplate.ContainerSlots = slots;
+  itemTemplate.BagFamily = bagFamily;
+  return itemTemplate;
+}
+
+static ItemTemplate const ITEMS[] = {
+    MakeItem(2589, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_CLOTH, 20),
+    MakeItem(4306, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_CLOTH, 20),
+    MakeItem(765, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_HERB, 20, BAG_FAMILY_MASK_HERBS),
+    MakeItem(2447, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_HERB, 20, BAG_FAMILY_MASK_HERBS),
+    MakeItem(2770, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_METAL_STONE, 20, BAG_FAMILY_MASK_MINING_SUPP),
+    MakeItem(1206, ITEM_CLASS_GEM, ITEM_SUBCLASS_GEM_GREEN, 20, BAG_FAMILY_MASK_MINING_SUPP),
+    MakeItem(10940, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_ENCHANTING, 20, BAG_FAMILY_MASK_ENCHANTING_SUPP),
+    MakeItem(4359, ITEM_CLASS_TRADE_GOODS, ITEM_SUBCLASS_PARTS, 200),
+    // Not taken by the bank
+    MakeItem(25, ITEM_CLASS_WEAPON, 7, 1),
+    MakeItem(6948, ITEM_CLASS_MISCELLANEOUS, 0, 1)};
+
+static ItemTemplate const BAGS[] = {
+    MakeBag(4500, 16, 0), MakeBag(856, 10, 0),
+    MakeBag(22250, 12, BAG_FAMILY_MASK_HERBS),
+    MakeBag(30746, 14, BAG_FAMILY_MASK_MINING_SUPP),
+    MakeBag(21340, 8, BAG_FAMILY_MASK_ENCHANTING_SUPP)};
+
+static ItemTemplate const *FindItem(uint32 entry)
+{
+  for (ItemTemplate const &itemTemplate : ITEMS)
+    if (itemTemplate.ItemId == entry)
+      return &itemTemplate;
+  return nullptr;
+}
+
+// Bags over the stand-in Player, storing items slot by slot the way the
+// core does: on top of existing stacks first, then into empty slots of
+// specialized bags taking the item, then into general slots
+class TestBags : public ReagentBankBags
+{
+public:
+  Player player;
+
+  bool IsAvailable() const override { return true; }
+  ReagentBankOwner GetOwner() const override { return {1, 0, 0}; }
+  uint32 GetCharacter() const override { return 1; }
+
+  std::vector<ReagentBankItemAmount>
+  TakeReagents(std::function<bool(ItemTemplate const *)> const &filter,
+               std::vector<uint32> &itemGuids) override
+  {
+    std::map<uint32, ReagentBankItemAmount> taken;
+    ForEachSlot(
+        [&](uint8 bag, uint8 slot, uint32)
+        {
+          Item *item = player.GetItemByPos(bag, slot);
+          if (!item || !filter(item->GetTemplate()))
+            return;
+          uint32 category = sReagentBankCategories->GetCategory(item->GetTemplate());
+          if (category == NO_REAGENT_BANK_CATEGORY)
+            return;
+          ReagentBankItemAmount &amount = taken[item->GetEntry()];
+          amount = {item->GetEntry(), category, amount.amount + item->GetCount()};
+          itemGuids.push_back(itemGuids.size() + 1);
+          player.SetItem(bag, slot, nullptr);
+        });
+    std::vector<ReagentBankItemAmount> amounts;
+    for (auto const &itr : taken)
+      amounts.push_back(itr.second);
+    return amounts;
+  }
+
+  ReagentBankBagPlanner PlanSpace() const override
+  {
+    return ReagentBankBagPlanner(const_cast<Player *>(&player));
+  }
+
+  uint32 Store(ItemTemplate const *itemTemplate, uint32 count) override
+  {
+    uint32 stackSize = itemTemplate->GetMaxStackSize();
+    uint32 stored = 0;
+    ForEachSlot(
+        [&](uint8 bag, uint8 slot, uint32)
+        {
+          Item *item = player.GetItemByPos(bag, slot);
+          if (stored == count || !item ||
+              item->GetEntry() != itemTemplate->ItemId ||
+              item->GetCount() >= stackSize)
+            return;
+          uint32 add = std::min(count - stored, stackSize - item->GetCount());
+          item->SetCount(item->GetCount() + add);
+          stored += add;
+        });
+    for (bool special : {true, false})
+      ForEachSlot(
+          [&](uint8 bag, uint8 slot, uint32 bagFamily)
+          {
+            if (stored == count || player.GetItemByPos(bag, slot) ||
+                (special ? !(bagFamily & itemTemplate->BagFamily) : bagFamily))
+              return;
+            uint32 add = std::min(count - stored, stackSize);
+            player.SetItem(bag, slot, std::make_unique<Item>(itemTemplate, add));
+            stored += add;
+          });
+    return stored;
+  }
+
+  void SendNoSpace(ItemTemplate const *, uint32) override {}
+  void SendMessage(std::string const &) override {}
+
+  // item entry -> count in the bags
+  std::map<uint32, uint32> GetCounts() const
+  {
+    std::map<uint32, uint32> counts;
+    ForEachSlot(
+        [&](uint8 bag, uint8 slot, uint32)
+        {
+          if (Item *item = player.GetItemByPos(bag, slot))
+            counts[item->GetEntry()] += item->GetCount();
+        });
+    return counts;
+  }
+
+private:
+  void ForEachSlot(std::function<void(uint8, uint8, uint32)> const &visit) const
+  {
+    for (uint8 i = INVENTORY_SLOT_ITEM_START; i < INVENTORY_SLOT_ITEM_END; ++i)
+      visit(INVENTORY_SLOT_BAG_0, i, 0);
+    for (uint8 i = INVENTORY_SLOT_BAG_START; i < INVENTORY_SLOT_BAG_END; ++i)
+      if (Bag *bag = player.GetBagByPos(i))
+        for (uint8 j = 0; j < bag->GetBagSize(); ++j)
+          visit(i, j, bag->GetTemplate()->BagFamily);
+  }
+};
+
+// Random bags, some of them specialized, partly filled with random stacks
+static void FillBags(TestBags &bags, std::mt19937 &random)
+{
+  for (uint8 i = INVENTORY_SLOT_BAG_START; i < INVENTORY_SLOT_BAG_END; ++i)
+    if (random() % 4)
+      bags.player.SetItem(INVENTORY_SLOT_BAG_0, i,
+                          std::make_unique<Bag>(&BAGS[random() % std::size(BAGS)]));
+  for (uint32 i = random() % 60; i > 0; --i)
+  {
+    ItemTemplate const &itemTemplate = ITEMS[random() % std::size(ITEMS)];
+    bags.Store(&itemTemplate, 1 + random() % itemTemplate.GetMaxStackSize());
+  }
+}
+
+REAGENT_BANK_TEST(Planner, ReserveMatchesStore)
+{
+  WorldDatabase.Clear();
+  sReagentBankCategories->Load();
+  for (uint32 seed = 1; seed <= 200; ++seed)
+  {
+    std::mt19937 random(seed);
+    TestBags bags;
+    FillBags(bags, random);
+
+    // A multi-entry withdraw: planned up front, then stored one by one
+    ReagentBankBagPlanner planner = bags.PlanSpace();
+    bool same = true;
+    for (uint32 i = 0; i < 8; ++i)
+    {
+      ItemTemplate const &itemTemplate = ITEMS[random() % std::size(ITEMS)];
+      uint32 count = 1 + random() % (3 * itemTemplate.GetMaxStackSize());
+      uint32 planned = planner.Reserve(&itemTemplate, count);
+      uint32 stored = bags.Store(&itemTemplate, count);
+      same = same && planned == stored;
+    }
+    if (!same)
+      std::printf("plan and bags differ with seed %u\n", seed);
+    CHECK(same);
+  }
+}
+
+REAGENT_BANK_TEST(Planner, SpecializedBagsTakeOnlyTheirItems)
+{
+  TestBags bags;
+  bags.player.SetItem(INVENTORY_SLOT_BAG_0, INVENTORY_SLOT_BAG_START,
+                      std::make_unique<Bag>(&BAGS[2]));
+  // The backpack full of things that do not stack
+  for (uint8 i = INVENTORY_SLOT_ITEM_START; i < INVENTORY_SLOT_ITEM_END; ++i)
+    bags.player.SetItem(INVENTORY_SLOT_BAG_0, i,
+                        std::make_unique<Item>(FindItem(25), 1));
+
+  ReagentBankBagPlanner planner = bags.PlanSpace();
+  CHECK_EQUAL(planner.Reserve(FindItem(2589), 1), 0u);
+  CHECK_EQUAL(planner.Reserve(FindItem(765), 100), 100u);
+  // The last stack of 765 has room for 140 - 100 more
+  CHECK_EQUAL(planner.Reserve(FindItem(765), 1000), 140u);
+  CHECK_EQUAL(planner.Reserve(FindItem(2447), 1), 0u);
+}
+
+REAGENT_BANK_TEST(Planner, BagsOfNoPlayer)
+{
+  ReagentBankBagPlanner planner(2, {{2589, 5}});
+  // 5 on top of the existing stack, 25 in two new ones
+  CHECK_EQUAL(planner.Reserve(FindItem(2589), 30), 30u);
+  CHECK_EQUAL(planner.Reserve(FindItem(2589), 30), 15u);
+  CHECK_EQUAL(planner.Reserve(FindItem(4306), 1), 0u);
+  // Specialized items fit into general slots too
+  ReagentBankBagPlanner general(1, {});
+  CHECK_EQUAL(general.Reserve(FindItem(765), 25), 20u);
+}
+
+// Replays random loot, deposits and withdraws between the bags and a bank
+// kept as a packed blob, the way the packed storage format keeps it, and
+// checks that no item is lost or duplicated on the way
+REAGENT_BANK_TEST(Planner, ReplayConservesItems)
+{
+  WorldDatabase.Clear();
+  sReagentBankCategories->Load();
+  for (uint32 seed = 1; seed <= 200; ++seed)
+  {
+    std::mt19937 random(seed);
+    TestBags bags;
+    FillBags(bags, random);
+    std::vector<uint8> blob = EncodeReagentBank(ReagentBankItemMap());
+    // item entry -> count in the bags or the bank
+    std::map<uint32, uint32> model = bags.GetCounts();
+
+    bool conserved = true;
+    bool readable = true;
+    for (uint32 step = 0; step < 100 && conserved && readable; ++step)
+    {
+      ReagentBankItemMap bank;
+      readable = DecodeReagentBank(blob, bank);
+      switch (random() % 4)
+      {
+        case 0:
+        {
+          ItemTemplate const &itemTemplate = ITEMS[random() % std::size(ITEMS)];
+          if (uint32 looted = bags.Store(&itemTemplate, 1 + random() % 50))
+            model[itemTemplate.ItemId] += looted;
+          break;
+        }
+        case 1:
+        {
+          // All reagents, or those of one category
+          uint32 category = random() % 2 ? ITEM_SUBCLASS_HERB : 0;
+          std::vector<uint32> itemGuids;
+          for (ReagentBankItemAmount const &amount : bags.TakeReagents(
+                   [category](ItemTemplate const *itemTemplate)
+                   {
+                     return !category ||
+                            sReagentBankCategories->GetCategory(itemTemplate) ==
+                                category;
+                   },
+                   itemGuids))
+          {
+            bank[amount.entry].subclass = amount.subclass;
+            bank[amount.entry].amount += amount.amount;
+          }
+          break;
+        }
+        default:
+        {
+          // Everything the bags take, planned up front like the engine does
+          ReagentBankBagPlanner planner = bags.PlanSpace();
+          for (auto itr = bank.begin(); itr != bank.end();)
+          {
+            ItemTemplate const *itemTemplate = FindItem(itr->first);
+            uint32 count = planner.Reserve(itemTemplate, itr->second.amount);
+            conserved = conserved && bags.Store(itemTemplate, count) == count;
+            itr->second.amount -= count;
+            if (!itr->second.amount)
+              itr = bank.erase(itr);
+            else
+              ++itr;
+          }
+          break;
+        }
+      }
+      blob = EncodeReagentBank(bank);
+
+      ReagentBankItemMap stored;
+      readable = readable && DecodeReagentBank(blob, stored);
+      std::map<uint32, uint32> counts = bags.GetCounts();
+      for (auto const &itr : stored)
+        counts[itr.first] += itr.second.amount;
+      conserved = conserved && counts == model;
+    }
+    if (!conserved || !readable)
+      std::printf("items not conserved with seed %u\n", seed);
+    CHECK(readable);
+    CHECK(conserved);
+  }
+}
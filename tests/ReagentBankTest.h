@@ -0,0 +1,61 @@
+#ifndef REAGENTBANK_TEST_H
+#define REAGENTBANK_TEST_H
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// A few macros in place of a test framework, so the tests build with
+// nothing but a compiler. Every test belongs to a suite, ctest runs the
+// suites one by one.
+struct ReagentBankTestCase
+{
+  char const *suite;
+  char const *name;
+  void (*run)();
+};
+
+std::vector<ReagentBankTestCase> &GetReagentBankTests();
+// Failed checks of the running test
+int &GetReagentBankTestFailures();
+
+struct ReagentBankTestRegistrar
+{
+  ReagentBankTestRegistrar(char const *suite, char const *name, void (*run)())
+  {
+    GetReagentBankTests().push_back({suite, name, run});
+  }
+};
+
+#define REAGENT_BANK_TEST(suite, name)                                         \
+  static void suite##_##name();                                                \
+  static ReagentBankTestRegistrar suite##_##name##_registrar(#suite, #name,    \
+                                                             suite##_##name);  \
+  static void suite##_##name()
+
+#define CHECK(condition)                                                       \
+  do                                                                           \
+  {                                                                            \
+    if (!(condition))                                                          \
+    {                                                                          \
+      std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__,             \
+                  #condition);                                                 \
+      ++GetReagentBankTestFailures();                                          \
+    }                                                                          \
+  } while (0)
+
+#define CHECK_EQUAL(actual, expected)                                          \
+  do                                                                           \
+  {                                                                            \
+    auto const &checkActual = (actual);                                        \
+    auto const &checkExpected = (expected);                                    \
+    if (!(checkActual == checkExpected))                                       \
+    {                                                                          \
+      std::printf("%s:%d: CHECK_EQUAL(%s, %s) failed: %s != %s\n", __FILE__,  \
+                  __LINE__, #actual, #expected,                                \
+                  std::to_string(checkActual).c_str(),                         \
+                  std::to_string(checkExpected).c_str());                      \
+      ++GetReagentBankTestFailures();                                          \
+    }                                                                          \
+  } while (0)
+
+#endif // REAGENTBANK_TEST_H
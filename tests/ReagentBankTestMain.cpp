@@ -0,0 +1,43 @@
+#include "DatabaseEnv.h"
+#include "ReagentBankTest.h"
+#include <cstring>
+
+DatabaseWorkerPool<CharacterDatabaseConnection> CharacterDatabase;
+DatabaseWorkerPool<WorldDatabaseConnection> WorldDatabase;
+
+std::vector<ReagentBankTestCase> &GetReagentBankTests()
+{
+  static std::vector<ReagentBankTestCase> tests;
+  return tests;
+}
+
+int &GetReagentBankTestFailures()
+{
+  static int failures = 0;
+  return failures;
+}
+
+// Runs the tests of the suite given as the argument, or all of them
+int main(int argc, char **argv)
+{
+  char const *suite = argc > 1 ? argv[1] : nullptr;
+  int run = 0;
+  int failed = 0;
+  for (ReagentBankTestCase const &test : GetReagentBankTests())
+  {
+    if (suite && std::strcmp(suite, test.suite) != 0)
+      continue;
+    GetReagentBankTestFailures() = 0;
+    test.run();
+    ++run;
+    if (GetReagentBankTestFailures())
+    {
+      ++failed;
+      std::printf("FAILED %s.%s\n", test.suite, test.name);
+    }
+    else
+      std::printf("passed %s.%s\n", test.suite, test.name);
+  }
+  std::printf("%d of %d tests passed\n", run - failed, run);
+  return (failed || !run) ? 1 : 0;
+}
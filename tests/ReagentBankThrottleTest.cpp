@@ -0,0 +1,104 @@
+#include "Config.h"
+#include "ReagentBankTest.h"
+#include "ReagentBankThrottle.h"
+#include "Timer.h"
+
+// The throttle is a singleton, so every test uses players of its own
+
+REAGENT_BANK_TEST(Throttle, BucketRefills)
+{
+  sConfigMgr->Reset();
+  sReagentBankThrottle->LoadConfig();
+  TestMSTime() = 1000;
+  for (uint32 i = 0; i < 10; ++i)
+    CHECK(sReagentBankThrottle->Allow(1));
+  uint64 throttled = sReagentBankThrottle->GetThrottledCount();
+  CHECK(!sReagentBankThrottle->Allow(1));
+  CHECK_EQUAL(sReagentBankThrottle->GetThrottledCount(), throttled + 1);
+  // Other players have buckets of their own
+  CHECK(sReagentBankThrottle->Allow(2));
+
+  // Four tokens a second
+  TestMSTime() += 250;
+  CHECK(sReagentBankThrottle->Allow(1));
+  CHECK(!sReagentBankThrottle->Allow(1));
+
+  // Never more than the burst
+  TestMSTime() += 60000;
+  for (uint32 i = 0; i < 10; ++i)
+    CHECK(sReagentBankThrottle->Allow(1));
+  CHECK(!sReagentBankThrottle->Allow(1));
+}
+
+REAGENT_BANK_TEST(Throttle, Configured)
+{
+  sConfigMgr->Reset();
+  sConfigMgr->SetOption("ReagentBankAccount.Throttle.Burst", "2");
+  sConfigMgr->SetOption("ReagentBankAccount.Throttle.PerSecond", "1");
+  sReagentBankThrottle->LoadConfig();
+  TestMSTime() = 5000;
+  CHECK(sReagentBankThrottle->Allow(10));
+  CHECK(sReagentBankThrottle->Allow(10));
+  CHECK(!sReagentBankThrottle->Allow(10));
+  TestMSTime() += 999;
+  CHECK(!sReagentBankThrottle->Allow(10));
+  TestMSTime() += 1;
+  CHECK(sReagentBankThrottle->Allow(10));
+
+  sConfigMgr->SetOption("ReagentBankAccount.Throttle.Enable", "0");
+  sReagentBankThrottle->LoadConfig();
+  for (uint32 i = 0; i < 100; ++i)
+    CHECK(sReagentBankThrottle->Allow(10));
+
+  sConfigMgr->Reset();
+  sReagentBankThrottle->LoadConfig();
+}
+
+REAGENT_BANK_TEST(Throttle, DepositsCoalesce)
+{
+  TestMSTime() = 1000;
+  CHECK(sReagentBankThrottle->BeginDeposit(20));
+  uint64 coalesced = sReagentBankThrottle->GetCoalescedCount();
+  CHECK(!sReagentBankThrottle->BeginDeposit(20));
+  CHECK(!sReagentBankThrottle->BeginDeposit(20));
+  CHECK_EQUAL(sReagentBankThrottle->GetCoalescedCount(), coalesced + 2);
+  // One more pass for all the merged ones
+  CHECK(sReagentBankThrottle->EndDeposit(20));
+  CHECK(sReagentBankThrottle->BeginDeposit(20));
+  CHECK(!sReagentBankThrottle->EndDeposit(20));
+}
+
+REAGENT_BANK_TEST(Throttle, StuckDepositIsGivenUp)
+{
+  TestMSTime() = 1000;
+  CHECK(sReagentBankThrottle->BeginDeposit(30));
+  TestMSTime() += DEPOSIT_IN_FLIGHT_TIMEOUT - 1;
+  CHECK(!sReagentBankThrottle->BeginDeposit(30));
+  TestMSTime() += 1;
+  CHECK(sReagentBankThrottle->BeginDeposit(30));
+  CHECK(!sReagentBankThrottle->EndDeposit(30));
+
+  // Across the wraparound of the clock
+  TestMSTime() = 0xFFFFFFFF - 1000;
+  CHECK(sReagentBankThrottle->BeginDeposit(31));
+  TestMSTime() += DEPOSIT_IN_FLIGHT_TIMEOUT / 2;
+  CHECK(!sReagentBankThrottle->BeginDeposit(31));
+  TestMSTime() += DEPOSIT_IN_FLIGHT_TIMEOUT;
+  CHECK(sReagentBankThrottle->BeginDeposit(31));
+}
+
+REAGENT_BANK_TEST(Throttle, OnlyLatestRenderIsShown)
+{
+  uint32 first = sReagentBankThrottle->BeginRender(40);
+  uint32 second = sReagentBankThrottle->BeginRender(40);
+  uint64 superseded = sReagentBankThrottle->GetSupersededCount();
+  CHECK(!sReagentBankThrottle->IsLatestRender(40, first));
+  CHECK(sReagentBankThrottle->IsLatestRender(40, second));
+  CHECK_EQUAL(sReagentBankThrottle->GetSupersededCount(), superseded + 1);
+
+  // Nothing is left of a player that logged out
+  CHECK(sReagentBankThrottle->BeginDeposit(40));
+  sReagentBankThrottle->RemovePlayer(40);
+  CHECK(!sReagentBankThrottle->IsLatestRender(40, second));
+  CHECK(!sReagentBankThrottle->EndDeposit(40));
+}
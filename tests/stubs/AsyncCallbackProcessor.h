@@ -0,0 +1,16 @@
+#ifndef REAGENTBANK_TEST_ASYNCCALLBACKPROCESSOR_H
+#define REAGENTBANK_TEST_ASYNCCALLBACKPROCESSOR_H
+#include <vector>
+
+// Nothing in the tests runs asynchronously; only the types are needed
+template <typename T> class AsyncCallbackProcessor
+{
+public:
+  void AddCallback(T &&callback) { m_callbacks.push_back(std::move(callback)); }
+  void ProcessReadyCallbacks() {}
+
+private:
+  std::vector<T> m_callbacks;
+};
+
+#endif // REAGENTBANK_TEST_ASYNCCALLBACKPROCESSOR_H
@@ -0,0 +1,13 @@
+#ifndef REAGENTBANK_TEST_BAG_H
+#define REAGENTBANK_TEST_BAG_H
+#include "Item.h"
+
+class Bag : public Item
+{
+public:
+  explicit Bag(ItemTemplate const *itemTemplate) : Item(itemTemplate, 1) {}
+
+  uint32 GetBagSize() const { return GetTemplate()->ContainerSlots; }
+};
+
+#endif // REAGENTBANK_TEST_BAG_H
@@ -0,0 +1,41 @@
+#ifndef REAGENTBANK_TEST_CONFIG_H
+#define REAGENTBANK_TEST_CONFIG_H
+#include <map>
+#include <sstream>
+#include <string>
+
+// Options the tests set, everything else is at its default
+class ConfigMgr
+{
+public:
+  static ConfigMgr *instance()
+  {
+    static ConfigMgr instance;
+    return &instance;
+  }
+
+  void SetOption(std::string const &name, std::string const &value)
+  {
+    m_options[name] = value;
+  }
+  void Reset() { m_options.clear(); }
+
+  template <typename T>
+  T GetOption(std::string const &name, T const &def, bool = true) const
+  {
+    auto it = m_options.find(name);
+    if (it == m_options.end())
+      return def;
+    // Through a wider type, so uint8 options are not read as characters
+    long long value = 0;
+    std::istringstream(it->second) >> value;
+    return T(value);
+  }
+
+private:
+  std::map<std::string, std::string> m_options;
+};
+
+#define sConfigMgr ConfigMgr::instance()
+
+#endif // REAGENTBANK_TEST_CONFIG_H
@@ -0,0 +1,131 @@
+#ifndef REAGENTBANK_TEST_DATABASEENV_H
+#define REAGENTBANK_TEST_DATABASEENV_H
+#include "Define.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+typedef std::vector<uint8> Binary;
+
+// One value of a row, kept as text like the client library returns it
+class Field
+{
+public:
+  Field() = default;
+  explicit Field(std::string value) : m_value(std::move(value)), m_null(false) {}
+
+  bool IsNull() const { return m_null; }
+
+  template <typename T> T Get() const
+  {
+    if constexpr (std::is_same_v<T, std::string>)
+      return m_value;
+    else if constexpr (std::is_same_v<T, Binary>)
+      return Binary(m_value.begin(), m_value.end());
+    else
+    {
+      long long value = 0;
+      std::istringstream(m_value) >> value;
+      return T(value);
+    }
+  }
+
+private:
+  std::string m_value;
+  bool m_null = true;
+};
+
+class ResultSet
+{
+public:
+  explicit ResultSet(std::vector<std::vector<Field>> rows) : m_rows(std::move(rows)) {}
+
+  Field *Fetch() { return m_rows[m_row].data(); }
+  Field &operator[](size_t index) { return m_rows[m_row][index]; }
+  bool NextRow() { return ++m_row < m_rows.size(); }
+  uint64 GetRowCount() const { return m_rows.size(); }
+
+private:
+  std::vector<std::vector<Field>> m_rows;
+  size_t m_row = 0;
+};
+
+typedef std::shared_ptr<ResultSet> QueryResult;
+
+class Transaction
+{
+public:
+  template <typename... Args> void Append(std::string_view sql, Args &&...)
+  {
+    m_statements.emplace_back(sql);
+  }
+
+private:
+  std::vector<std::string> m_statements;
+};
+
+typedef std::shared_ptr<Transaction> CharacterDatabaseTransaction;
+
+class QueryCallback;
+
+class TransactionCallback
+{
+public:
+  TransactionCallback &&AfterComplete(std::function<void(bool)> callback) &&
+  {
+    m_callback = std::move(callback);
+    return std::move(*this);
+  }
+
+private:
+  std::function<void(bool)> m_callback;
+};
+
+// In-memory backend: every table is a list of rows, and a query returns
+// all rows of the table named after its FROM. Enough for the loaders,
+// which read whole tables.
+template <typename T> class DatabaseWorkerPool
+{
+public:
+  void SetTable(std::string const &name,
+                std::vector<std::vector<std::string>> const &rows)
+  {
+    std::vector<std::vector<Field>> &table = m_tables[name];
+    table.clear();
+    for (std::vector<std::string> const &row : rows)
+    {
+      table.emplace_back();
+      for (std::string const &value : row)
+        table.back().emplace_back(value);
+    }
+  }
+  void Clear() { m_tables.clear(); }
+
+  template <typename... Args> QueryResult Query(std::string_view sql, Args &&...)
+  {
+    size_t from = sql.find(" FROM ");
+    if (from == std::string_view::npos)
+      return nullptr;
+    std::string_view name = sql.substr(from + 6);
+    name = name.substr(0, name.find(' '));
+    auto it = m_tables.find(std::string(name));
+    if (it == m_tables.end() || it->second.empty())
+      return nullptr;
+    return std::make_shared<ResultSet>(it->second);
+  }
+
+private:
+  std::map<std::string, std::vector<std::vector<Field>>> m_tables;
+};
+
+class CharacterDatabaseConnection;
+class WorldDatabaseConnection;
+extern DatabaseWorkerPool<CharacterDatabaseConnection> CharacterDatabase;
+extern DatabaseWorkerPool<WorldDatabaseConnection> WorldDatabase;
+
+#endif // REAGENTBANK_TEST_DATABASEENV_H
@@ -0,0 +1,22 @@
+#ifndef REAGENTBANK_TEST_DEFINE_H
+#define REAGENTBANK_TEST_DEFINE_H
+#include <cstdint>
+
+// Stand-ins for the core headers, just enough of them to build the parts of
+// the module that need no worldserver
+
+typedef std::int8_t int8;
+typedef std::int16_t int16;
+typedef std::int32_t int32;
+typedef std::int64_t int64;
+typedef std::uint8_t uint8;
+typedef std::uint16_t uint16;
+typedef std::uint32_t uint32;
+typedef std::uint64_t uint64;
+
+#define MINUTE 60
+#define HOUR (MINUTE * 60)
+#define DAY (HOUR * 24)
+#define IN_MILLISECONDS 1000
+
+#endif // REAGENTBANK_TEST_DEFINE_H
@@ -0,0 +1,24 @@
+#ifndef REAGENTBANK_TEST_ITEM_H
+#define REAGENTBANK_TEST_ITEM_H
+#include "ItemTemplate.h"
+
+class Item
+{
+public:
+  Item(ItemTemplate const *itemTemplate, uint32 count)
+      : m_template(itemTemplate), m_count(count)
+  {
+  }
+  virtual ~Item() = default;
+
+  ItemTemplate const *GetTemplate() const { return m_template; }
+  uint32 GetEntry() const { return m_template->ItemId; }
+  uint32 GetCount() const { return m_count; }
+  void SetCount(uint32 count) { m_count = count; }
+
+private:
+  ItemTemplate const *m_template;
+  uint32 m_count;
+};
+
+#endif // REAGENTBANK_TEST_ITEM_H
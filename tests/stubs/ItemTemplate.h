@@ -0,0 +1,76 @@
+#ifndef REAGENTBANK_TEST_ITEMTEMPLATE_H
+#define REAGENTBANK_TEST_ITEMTEMPLATE_H
+#include "Define.h"
+#include <string>
+
+enum ItemClass : uint8 {
+  ITEM_CLASS_CONSUMABLE = 0,
+  ITEM_CLASS_CONTAINER = 1,
+  ITEM_CLASS_WEAPON = 2,
+  ITEM_CLASS_GEM = 3,
+  ITEM_CLASS_ARMOR = 4,
+  ITEM_CLASS_REAGENT = 5,
+  ITEM_CLASS_PROJECTILE = 6,
+  ITEM_CLASS_TRADE_GOODS = 7,
+  ITEM_CLASS_GENERIC = 8,
+  ITEM_CLASS_RECIPE = 9,
+  ITEM_CLASS_MONEY = 10,
+  ITEM_CLASS_QUIVER = 11,
+  ITEM_CLASS_QUEST = 12,
+  ITEM_CLASS_KEY = 13,
+  ITEM_CLASS_PERMANENT = 14,
+  ITEM_CLASS_MISCELLANEOUS = 15,
+  ITEM_CLASS_GLYPH = 16
+};
+
+#define MAX_ITEM_CLASS 17
+
+enum ItemSubclassTradeGoods : uint8 {
+  ITEM_SUBCLASS_TRADE_GOODS = 0,
+  ITEM_SUBCLASS_PARTS = 1,
+  ITEM_SUBCLASS_EXPLOSIVES = 2,
+  ITEM_SUBCLASS_DEVICES = 3,
+  ITEM_SUBCLASS_JEWELCRAFTING = 4,
+  ITEM_SUBCLASS_CLOTH = 5,
+  ITEM_SUBCLASS_LEATHER = 6,
+  ITEM_SUBCLASS_METAL_STONE = 7,
+  ITEM_SUBCLASS_MEAT = 8,
+  ITEM_SUBCLASS_HERB = 9,
+  ITEM_SUBCLASS_ELEMENTAL = 10,
+  ITEM_SUBCLASS_TRADE_GOODS_OTHER = 11,
+  ITEM_SUBCLASS_ENCHANTING = 12,
+  ITEM_SUBCLASS_MATERIAL = 13,
+  ITEM_SUBCLASS_ARMOR_ENCHANTMENT = 14,
+  ITEM_SUBCLASS_WEAPON_ENCHANTMENT = 15
+};
+
+enum ItemSubclassGem : uint8 {
+  ITEM_SUBCLASS_GEM_RED = 0,
+  ITEM_SUBCLASS_GEM_BLUE = 1,
+  ITEM_SUBCLASS_GEM_YELLOW = 2,
+  ITEM_SUBCLASS_GEM_PURPLE = 3,
+  ITEM_SUBCLASS_GEM_GREEN = 4,
+  ITEM_SUBCLASS_GEM_ORANGE = 5,
+  ITEM_SUBCLASS_GEM_META = 6,
+  ITEM_SUBCLASS_GEM_SIMPLE = 7,
+  ITEM_SUBCLASS_GEM_PRISMATIC = 8
+};
+
+struct ItemTemplate
+{
+  uint32 ItemId = 0;
+  uint32 Class = 0;
+  uint32 SubClass = 0;
+  std::string Name1;
+  int32 Stackable = 1;
+  uint32 BagFamily = 0;
+  uint32 ContainerSlots = 0;
+
+  uint32 GetMaxStackSize() const
+  {
+    return (Stackable == 2147483647 || Stackable <= 0) ? uint32(0x7FFFFFFF - 1)
+                                                      : uint32(Stackable);
+  }
+};
+
+#endif // REAGENTBANK_TEST_ITEMTEMPLATE_H
@@ -0,0 +1,24 @@
+#ifndef REAGENTBANK_TEST_OBJECTGUID_H
+#define REAGENTBANK_TEST_OBJECTGUID_H
+#include "Define.h"
+
+class ObjectGuid
+{
+public:
+  ObjectGuid() = default;
+  explicit ObjectGuid(uint64 raw) : m_raw(raw) {}
+
+  uint64 GetRawValue() const { return m_raw; }
+  uint32 GetCounter() const { return uint32(m_raw); }
+  bool IsEmpty() const { return !m_raw; }
+  bool operator==(ObjectGuid const &other) const { return m_raw == other.m_raw; }
+
+  static ObjectGuid const Empty;
+
+private:
+  uint64 m_raw = 0;
+};
+
+inline ObjectGuid const ObjectGuid::Empty;
+
+#endif // REAGENTBANK_TEST_OBJECTGUID_H
@@ -0,0 +1,49 @@
+#ifndef REAGENTBANK_TEST_PLAYER_H
+#define REAGENTBANK_TEST_PLAYER_H
+#include "Bag.h"
+#include "ObjectGuid.h"
+#include <map>
+#include <memory>
+#include <utility>
+
+enum InventorySlots : uint8 {
+  INVENTORY_SLOT_BAG_0 = 255,
+  INVENTORY_SLOT_BAG_START = 19,
+  INVENTORY_SLOT_BAG_END = 23,
+  INVENTORY_SLOT_ITEM_START = 23,
+  INVENTORY_SLOT_ITEM_END = 39
+};
+
+// Only the inventory: the backpack and up to four bags, which the tests
+// fill by hand
+class Player
+{
+public:
+  explicit Player(ObjectGuid guid = ObjectGuid()) : m_guid(guid) {}
+
+  ObjectGuid GetGUID() const { return m_guid; }
+
+  Item *GetItemByPos(uint8 bag, uint8 slot) const
+  {
+    auto it = m_items.find({bag, slot});
+    return it != m_items.end() ? it->second.get() : nullptr;
+  }
+  Bag *GetBagByPos(uint8 slot) const
+  {
+    return dynamic_cast<Bag *>(GetItemByPos(INVENTORY_SLOT_BAG_0, slot));
+  }
+
+  void SetItem(uint8 bag, uint8 slot, std::unique_ptr<Item> item)
+  {
+    if (item)
+      m_items[{bag, slot}] = std::move(item);
+    else
+      m_items.erase({bag, slot});
+  }
+
+private:
+  ObjectGuid m_guid;
+  std::map<std::pair<uint8, uint8>, std::unique_ptr<Item>> m_items;
+};
+
+#endif // REAGENTBANK_TEST_PLAYER_H
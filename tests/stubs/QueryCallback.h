@@ -0,0 +1,30 @@
+#ifndef REAGENTBANK_TEST_QUERYCALLBACK_H
+#define REAGENTBANK_TEST_QUERYCALLBACK_H
+#include "AsyncCallbackProcessor.h"
+#include "DatabaseEnv.h"
+#include <functional>
+
+class QueryCallback
+{
+public:
+  QueryCallback &&WithCallback(std::function<void(QueryResult)> callback) &&
+  {
+    m_callbacks.push_back(
+        [callback](QueryCallback &, QueryResult result) { callback(result); });
+    return std::move(*this);
+  }
+  QueryCallback &&
+  WithChainingCallback(std::function<void(QueryCallback &, QueryResult)> callback) &&
+  {
+    m_callbacks.push_back(std::move(callback));
+    return std::move(*this);
+  }
+  void SetNextQuery(QueryCallback &&) {}
+
+private:
+  std::vector<std::function<void(QueryCallback &, QueryResult)>> m_callbacks;
+};
+
+typedef AsyncCallbackProcessor<QueryCallback> QueryCallbackProcessor;
+
+#endif // REAGENTBANK_TEST_QUERYCALLBACK_H
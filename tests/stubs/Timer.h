@@ -0,0 +1,26 @@
+#ifndef REAGENTBANK_TEST_TIMER_H
+#define REAGENTBANK_TEST_TIMER_H
+#include "Define.h"
+
+// A clock the tests move by hand
+inline uint32 &TestMSTime()
+{
+  static uint32 time = 0;
+  return time;
+}
+
+inline uint32 getMSTime() { return TestMSTime(); }
+
+inline uint32 getMSTimeDiff(uint32 oldMSTime, uint32 newMSTime)
+{
+  if (oldMSTime > newMSTime)
+    return (0xFFFFFFFF - oldMSTime) + newMSTime;
+  return newMSTime - oldMSTime;
+}
+
+inline uint32 GetMSTimeDiffToNow(uint32 oldMSTime)
+{
+  return getMSTimeDiff(oldMSTime, getMSTime());
+}
+
+#endif // REAGENTBANK_TEST_TIMER_H